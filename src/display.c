@@ -0,0 +1,314 @@
+/*
+ * In-RAM display model and the render thread that pushes it to the LCD
+ *
+ * Every page has its own buffer, kept up to date whether or not it is on the
+ * glass, so a page switch is a local redraw. Protocol handlers only edit the
+ * buffers. The render thread wakes when the visible page changes, copies it
+ * into the LCD frame buffer and flushes, at most DISPLAY_RENDER_HZ times a
+ * second. Several updates to the same cells between two renders therefore
+ * cost a single bus write.
+ *
+ * A page can also be a marquee: its rows hold up to a full DDRAM line and the
+ * render thread slides the visible window across them with display shift
+ * commands, one bus command per step, pausing with either end in view.
+ *
+ * Buffers hold glyphs as model codes; the render thread maps them to CGRAM
+ * slots through the glyph manager and runs its animations.
+ */
+
+#include "display.h"
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <string.h>
+
+LOG_MODULE_REGISTER(display, LOG_LEVEL_INF);
+
+/* LCD owned by the render thread, NULL until display_init */
+static lcd_state_t *display_lcd;
+
+/* Page buffers and the visible page, guarded by model_lock. Blank from boot, so anything
+ * written before display_init is kept */
+static uint8_t model[DISPLAY_PAGES][LCD_MAX_ROWS][LCD_DDRAM_COLS] = {
+    [0 ... DISPLAY_PAGES - 1] = { [0 ... LCD_MAX_ROWS - 1] = { [0 ... LCD_DDRAM_COLS - 1] = ' ' } }
+};
+static uint8_t visible_page;
+static bool row_dirty[LCD_MAX_ROWS];
+K_MUTEX_DEFINE(model_lock);
+
+/* Render thread only: the visible page as of the last render, still in model codes */
+static uint8_t rendered[LCD_MAX_ROWS][LCD_DDRAM_COLS];
+
+/* Content width of each page's marquee, 0 for none; guarded by model_lock */
+static uint8_t marquee_width[DISPLAY_PAGES];
+static bool marquee_restart;
+
+/* Render thread only: shift at which the right end of the content is in view, 0 when the
+ * visible page isn't scrolling, and when the next step is due */
+static uint8_t marquee_span;
+static int64_t marquee_next_step;
+
+/* Start of the oldest RX burst waiting for the next render, and the latency of those already
+ * rendered; guarded by model_lock */
+static bool rx_pending;
+static uint32_t rx_pending_start;
+static struct display_latency latency;
+
+/* Given whenever the visible page changes */
+K_SEM_DEFINE(render_sem, 0, 1);
+
+/* Given on a page switch to cut the frame-rate pause short */
+K_SEM_DEFINE(page_switch_sem, 0, 1);
+
+/* Put the window back at the left edge and scroll the visible page if its content is wider */
+static void marquee_start(lcd_state_t *lcd, uint8_t width)
+{
+    if (lcd->display_shift != 0) {
+        lcd_home(lcd);
+    }
+
+    /* On four-line modules a shift moves rows between lines, so only two-line ones scroll */
+    marquee_span = (lcd->config.rows <= 2 && width > lcd->config.cols) ? width - lcd->config.cols : 0;
+    marquee_next_step = k_uptime_get() + CONFIG_DISPLAY_MARQUEE_PAUSE_MS;
+}
+
+/* Move the window one column, or jump back to the start once the end has been shown */
+static void marquee_step(lcd_state_t *lcd)
+{
+    if (lcd->display_shift < marquee_span) {
+        lcd_scroll_display_left(lcd);
+        marquee_next_step = k_uptime_get() + (lcd->display_shift == marquee_span ?
+                                              CONFIG_DISPLAY_MARQUEE_PAUSE_MS :
+                                              CONFIG_DISPLAY_MARQUEE_STEP_MS);
+    } else {
+        lcd_home(lcd);
+        marquee_next_step = k_uptime_get() + CONFIG_DISPLAY_MARQUEE_PAUSE_MS;
+    }
+}
+
+static void render_thread(void *p1, void *p2, void *p3)
+{
+    /* Not a page, so the first render sets up the marquee state */
+    uint8_t rendered_page = DISPLAY_PAGES;
+
+    while (1) {
+        k_timeout_t wait = K_FOREVER;
+
+        /* Between renders, wake for marquee steps and glyph animation frames */
+        int64_t next = glyph_next_frame();
+        if (marquee_span > 0) {
+            next = MIN(next, marquee_next_step);
+        }
+        if (next != INT64_MAX) {
+            int64_t now = k_uptime_get();
+            if (next <= now) {
+                if (marquee_span > 0 && marquee_next_step <= now) {
+                    marquee_step(display_lcd);
+                }
+                glyph_animate(display_lcd, now);
+                continue;
+            }
+            wait = K_MSEC(next - now);
+        }
+
+        if (k_sem_take(&render_sem, wait) != 0 || display_lcd == NULL) {
+            continue;
+        }
+
+        /* Copy the changed rows out quickly so handlers are never blocked on the bus */
+        k_mutex_lock(&model_lock, K_FOREVER);
+        for (uint8_t row = 0; row < display_lcd->config.rows; row++) {
+            if (row_dirty[row]) {
+                memcpy(rendered[row], model[visible_page][row], display_lcd->ddram_cols);
+                row_dirty[row] = false;
+            }
+        }
+        bool restart = marquee_restart || rendered_page != visible_page;
+        uint8_t width = marquee_width[visible_page];
+        bool measure = rx_pending;
+        uint32_t rx_start = rx_pending_start;
+        marquee_restart = false;
+        rendered_page = visible_page;
+        rx_pending = false;
+        k_mutex_unlock(&model_lock);
+
+        if (restart) {
+            marquee_start(display_lcd, width);
+        }
+
+        /* Map every row, not only the changed ones, so glyphs still on the glass keep their
+         * slots. Unchanged cells cost nothing at flush */
+        glyph_begin_frame();
+        for (uint8_t row = 0; row < display_lcd->config.rows; row++) {
+            uint8_t mapped[LCD_DDRAM_COLS];
+
+            glyph_map(display_lcd, mapped, rendered[row], display_lcd->ddram_cols);
+            lcd_fb_write(display_lcd, row, 0, mapped, display_lcd->ddram_cols);
+        }
+
+        int written = lcd_flush(display_lcd);
+        LOG_DBG("Rendered %d cells", written);
+
+        if (measure) {
+            uint32_t latency_us = k_cyc_to_us_floor32(k_cycle_get_32() - rx_start);
+
+            k_mutex_lock(&model_lock, K_FOREVER);
+            latency.renders++;
+            latency.sum_us += latency_us;
+            latency.max_us = MAX(latency.max_us, latency_us);
+            k_mutex_unlock(&model_lock);
+        }
+
+        /* Cap the frame rate; updates arriving meanwhile merge into the next render.
+         * A page switch ends the pause early so it is never delayed by a frame */
+        k_sem_take(&page_switch_sem, K_MSEC(1000 / DISPLAY_RENDER_HZ));
+    }
+}
+
+K_THREAD_DEFINE(render_tid, DISPLAY_RENDER_STACK_SIZE, render_thread, NULL, NULL, NULL,
+                DISPLAY_RENDER_PRIORITY, 0, 0);
+
+/* Mark rows of a page as changed, waking the render thread if it is visible.
+ * Call with model_lock held */
+static void display_mark_dirty(uint8_t page, uint8_t first_row, uint8_t last_row)
+{
+    if (page != visible_page) {
+        return;
+    }
+
+    for (uint8_t row = first_row; row <= last_row; row++) {
+        row_dirty[row] = true;
+    }
+    k_sem_give(&render_sem);
+}
+
+void display_init(lcd_state_t *lcd)
+{
+    k_mutex_lock(&model_lock, K_FOREVER);
+    for (uint8_t row = 0; row < LCD_MAX_ROWS; row++) {
+        row_dirty[row] = true;
+    }
+    display_lcd = lcd;
+    k_mutex_unlock(&model_lock);
+}
+
+void display_set_page(uint8_t page)
+{
+    if (page >= DISPLAY_PAGES) {
+        return;
+    }
+
+    k_mutex_lock(&model_lock, K_FOREVER);
+    visible_page = page;
+    display_mark_dirty(page, 0, LCD_MAX_ROWS - 1);
+    k_mutex_unlock(&model_lock);
+
+    k_sem_give(&page_switch_sem);
+}
+
+uint8_t display_get_page(void)
+{
+    return visible_page;
+}
+
+void display_clear(uint8_t page)
+{
+    if (page >= DISPLAY_PAGES) {
+        return;
+    }
+
+    k_mutex_lock(&model_lock, K_FOREVER);
+    memset(model[page], ' ', sizeof(model[page]));
+    display_mark_dirty(page, 0, LCD_MAX_ROWS - 1);
+    k_mutex_unlock(&model_lock);
+}
+
+void display_put_char(uint8_t page, uint8_t row, uint8_t col, uint8_t c)
+{
+    display_write(page, row, col, &c, 1);
+}
+
+void display_write(uint8_t page, uint8_t row, uint8_t col, const uint8_t *data, size_t len)
+{
+    if (page >= DISPLAY_PAGES || row >= LCD_MAX_ROWS || col >= LCD_DDRAM_COLS || len == 0) {
+        return;
+    }
+
+    len = MIN(len, (size_t)(LCD_DDRAM_COLS - col));
+
+    k_mutex_lock(&model_lock, K_FOREVER);
+    memcpy(&model[page][row][col], data, len);
+    display_mark_dirty(page, row, row);
+    k_mutex_unlock(&model_lock);
+}
+
+void display_print(uint8_t page, uint8_t row, uint8_t col, const char *str)
+{
+    display_write(page, row, col, (const uint8_t *)str, strlen(str));
+}
+
+size_t display_read(uint8_t page, uint8_t row, uint8_t col, uint8_t *out, size_t len)
+{
+    if (page >= DISPLAY_PAGES || row >= LCD_MAX_ROWS || col >= LCD_DDRAM_COLS) {
+        return 0;
+    }
+
+    len = MIN(len, (size_t)(LCD_DDRAM_COLS - col));
+
+    k_mutex_lock(&model_lock, K_FOREVER);
+    memcpy(out, &model[page][row][col], len);
+    k_mutex_unlock(&model_lock);
+
+    return len;
+}
+
+void display_set_marquee(uint8_t page, uint8_t width)
+{
+    if (page >= DISPLAY_PAGES) {
+        return;
+    }
+
+    k_mutex_lock(&model_lock, K_FOREVER);
+    marquee_width[page] = MIN(width, LCD_DDRAM_COLS);
+    if (page == visible_page) {
+        marquee_restart = true;
+        k_sem_give(&render_sem);
+    }
+    k_mutex_unlock(&model_lock);
+}
+
+void display_animate_glyph(glyph_id_t id, uint16_t frame_ms)
+{
+    glyph_set_frame_ms(id, frame_ms);
+
+    /* The render thread may be asleep with nothing animating; let it pick up the new rate */
+    k_sem_give(&render_sem);
+}
+
+void display_set_glyph_bitmap(glyph_id_t id, const uint8_t bitmap[GLYPH_HEIGHT])
+{
+    glyph_set_bitmap(id, bitmap);
+    k_sem_give(&render_sem);
+}
+
+void display_note_rx(uint32_t start_cycle)
+{
+    k_mutex_lock(&model_lock, K_FOREVER);
+    if (!rx_pending) {
+        for (uint8_t row = 0; row < LCD_MAX_ROWS; row++) {
+            if (row_dirty[row]) {
+                rx_pending = true;
+                rx_pending_start = start_cycle;
+                break;
+            }
+        }
+    }
+    k_mutex_unlock(&model_lock);
+}
+
+void display_latency_take(struct display_latency *out)
+{
+    k_mutex_lock(&model_lock, K_FOREVER);
+    *out = latency;
+    memset(&latency, 0, sizeof(latency));
+    k_mutex_unlock(&model_lock);
+}
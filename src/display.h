@@ -0,0 +1,75 @@
+/*
+ * In-RAM display model and the render thread that pushes it to the LCD
+ */
+
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <zephyr/kernel.h>
+#include "drivers/lcd/lcd.h"
+#include "glyphs.h"
+
+/* One pre-rendered buffer per keypad page (R_PAGE..S_PAGE) */
+#define DISPLAY_PAGES       5
+
+/* Upper bound on how often the render thread flushes the model to the glass */
+#define DISPLAY_RENDER_HZ   20
+
+/* Render thread configuration; lower priority than the main loop */
+#define DISPLAY_RENDER_STACK_SIZE   1024
+#define DISPLAY_RENDER_PRIORITY     7
+
+/* Hand the LCD over to the render thread, which replaces what is on it with the visible page.
+ * The caller must not touch the LCD directly afterwards */
+void display_init(lcd_state_t *lcd);
+
+/* Show another page; rendered straight away from its buffer */
+void display_set_page(uint8_t page);
+
+/* Page currently on the glass */
+uint8_t display_get_page(void);
+
+/* Blank a page buffer */
+void display_clear(uint8_t page);
+
+/* Place a single character, or a glyph as GLYPH_CODE(id), in a page buffer */
+void display_put_char(uint8_t page, uint8_t row, uint8_t col, uint8_t c);
+
+/* Copy len raw bytes into a page buffer starting at (row, col) */
+void display_write(uint8_t page, uint8_t row, uint8_t col, const uint8_t *data, size_t len);
+
+/* Copy a string into a page buffer starting at (row, col) */
+void display_print(uint8_t page, uint8_t row, uint8_t col, const char *str);
+
+/* Copy up to len cells of a page buffer starting at (row, col) into out, glyphs as model codes.
+ * Returns the number of cells copied */
+size_t display_read(uint8_t page, uint8_t row, uint8_t col, uint8_t *out, size_t len);
+
+/* Scroll a page while it is visible, for content up to width columns wide (at most one DDRAM
+ * line). The content is written once and moved with display shift commands, so every row of
+ * the page scrolls together, one column every CONFIG_DISPLAY_MARQUEE_STEP_MS with a
+ * CONFIG_DISPLAY_MARQUEE_PAUSE_MS rest at each end. Starts over from the left edge; a width that
+ * fits the glass stops it */
+void display_set_marquee(uint8_t page, uint8_t width);
+
+/* Animate a glyph wherever it is shown, frame_ms per frame; 0 holds the current frame */
+void display_animate_glyph(glyph_id_t id, uint16_t frame_ms);
+
+/* Give a dynamic glyph a new bitmap; every cell showing it changes without a DDRAM write */
+void display_set_glyph_bitmap(glyph_id_t id, const uint8_t bitmap[GLYPH_HEIGHT]);
+
+/* Time from the first byte of an RX burst until its updates were flushed to the glass */
+struct display_latency {
+    uint32_t renders;   /* Renders that carried RX updates */
+    uint32_t sum_us;
+    uint32_t max_us;
+};
+
+/* Note that updates from an RX burst starting at start_cycle (k_cycle_get_32) are in the model.
+ * The next render measures them to the glass; a burst that changed nothing visible is ignored */
+void display_note_rx(uint32_t start_cycle);
+
+/* Copy the latency stats gathered since the last call, then reset them */
+void display_latency_take(struct display_latency *out);
+
+#endif /* DISPLAY_H */
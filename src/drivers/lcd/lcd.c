@@ -9,56 +9,279 @@
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/drivers/adc.h>
 #include <zephyr/logging/log.h>
+#include <string.h>
+
+#ifdef LCD_EMUL
+#include "lcd_emul.h"
+#endif
 
 LOG_MODULE_REGISTER(lcd, LOG_LEVEL_INF);
 
 /* Row offset addresses for different LCD sizes */
 static const uint8_t ROW_OFFSETS[] = {0x00, 0x40, 0x14, 0x54};
 
+/* Datasheet execution times at 270 kHz plus margin for slow clones */
+#define LCD_DEFAULT_DATA_US        50
+#define LCD_DEFAULT_DDRAM_ADDR_US  50
+#define LCD_DEFAULT_CLEAR_HOME_US  2000
+#define LCD_DEFAULT_CGRAM_ADDR_US  50
+
+/* Give up polling the busy flag after this long and assume the controller is hung */
+#define LCD_BUSY_TIMEOUT_US        5000
+
+#ifdef LCD_BENCHMARK
+/* Bus activity counters for the benchmarks; only the bus paths below are counted */
+static lcd_bus_stats_t bus_stats;
+
+#define LCD_GPIO_SET(dev, pin, value) \
+    (bus_stats.gpio_calls++, gpio_pin_set(dev, pin, value))
+#define LCD_GPIO_GET(dev, pin) \
+    (bus_stats.gpio_calls++, gpio_pin_get(dev, pin))
+#define LCD_PORT_SET(dev, mask, value) \
+    (bus_stats.gpio_calls++, gpio_port_set_masked_raw(dev, mask, value))
+#define LCD_GPIO_CONFIGURE(dev, pin, flags) \
+    (bus_stats.gpio_calls++, gpio_pin_configure(dev, pin, flags))
+#define LCD_BUSY_WAIT(us) \
+    do { bus_stats.busy_wait_us += (us); k_busy_wait(us); } while (0)
+#define LCD_SLEEP_US(us) \
+    do { bus_stats.sleep_us += (us); k_usleep(us); } while (0)
+#define LCD_COUNT_BYTE() (bus_stats.bytes++)
+#else
+#define LCD_GPIO_SET(dev, pin, value) gpio_pin_set(dev, pin, value)
+#define LCD_GPIO_GET(dev, pin) gpio_pin_get(dev, pin)
+#define LCD_PORT_SET(dev, mask, value) gpio_port_set_masked_raw(dev, mask, value)
+#define LCD_GPIO_CONFIGURE(dev, pin, flags) gpio_pin_configure(dev, pin, flags)
+#define LCD_BUSY_WAIT(us) k_busy_wait(us)
+#define LCD_SLEEP_US(us) k_usleep(us)
+#define LCD_COUNT_BYTE()
+#endif
+
+/* Mark frame cells [first, last] of a row as touched since the last flush */
+static void lcd_mark_dirty(lcd_state_t *lcd, uint8_t row, uint8_t first, uint8_t last)
+{
+    lcd->dirty_lo[row] = MIN(lcd->dirty_lo[row], first);
+    lcd->dirty_hi[row] = MAX(lcd->dirty_hi[row], last);
+}
+
+/* Forget all pending frame changes */
+static void lcd_mark_clean(lcd_state_t *lcd)
+{
+    memset(lcd->dirty_lo, 0xFF, sizeof(lcd->dirty_lo));
+    memset(lcd->dirty_hi, 0x00, sizeof(lcd->dirty_hi));
+}
+
+/* Track the controller address counter after a DDRAM data write */
+static void lcd_advance_ddram_addr(lcd_state_t *lcd)
+{
+    lcd->ddram_addr++;
+
+    /* In two-line mode the counter wraps from the end of one line to the start of the next */
+    if (lcd->ddram_addr == ROW_OFFSETS[0] + LCD_DDRAM_COLS) {
+        lcd->ddram_addr = ROW_OFFSETS[1];
+    } else if (lcd->ddram_addr == ROW_OFFSETS[1] + LCD_DDRAM_COLS) {
+        lcd->ddram_addr = ROW_OFFSETS[0];
+    }
+}
+
+/* Record a character written straight to the glass at the current address */
+static void lcd_shadow_store(lcd_state_t *lcd, uint8_t c)
+{
+    if (!lcd->ddram_addr_valid) {
+        return;
+    }
+
+    for (uint8_t row = 0; row < lcd->config.rows; row++) {
+        if (lcd->ddram_addr >= ROW_OFFSETS[row] &&
+            lcd->ddram_addr < ROW_OFFSETS[row] + lcd->ddram_cols) {
+            uint8_t col = lcd->ddram_addr - ROW_OFFSETS[row];
+            lcd->shadow[row][col] = c;
+            lcd->frame[row][col] = c;
+            break;
+        }
+    }
+
+    lcd_advance_ddram_addr(lcd);
+}
+
 /* Helper function to pulse the enable pin */
 static void lcd_pulse_enable(lcd_state_t *lcd)
 {
-    gpio_pin_set(lcd->config.enable_gpio_dev, lcd->config.enable_pin, 0);
-    k_busy_wait(1);
-    gpio_pin_set(lcd->config.enable_gpio_dev, lcd->config.enable_pin, 1);
-    k_busy_wait(1);
-    gpio_pin_set(lcd->config.enable_gpio_dev, lcd->config.enable_pin, 0);
-    k_busy_wait(100);  /* Commands need > 37us to settle */
+    LCD_GPIO_SET(lcd->config.enable_gpio_dev, lcd->config.enable_pin, 0);
+    LCD_BUSY_WAIT(1);
+    LCD_GPIO_SET(lcd->config.enable_gpio_dev, lcd->config.enable_pin, 1);
+    LCD_BUSY_WAIT(1);
+    LCD_GPIO_SET(lcd->config.enable_gpio_dev, lcd->config.enable_pin, 0);
+#ifdef LCD_EMUL
+    /* The controller latches on the falling edge */
+    lcd_emul_latch(&lcd->config);
+#endif
+    LCD_BUSY_WAIT(1);  /* Enable cycle time; execution delay is handled per byte */
+}
+
+/* Drive D4-D7 one pin at a time, for wiring that spans several ports */
+static void lcd_set_data_pins(lcd_state_t *lcd, uint8_t value)
+{
+    LCD_GPIO_SET(lcd->config.d4_gpio_dev, lcd->config.d4_pin, (value >> 0) & 0x01);
+    LCD_GPIO_SET(lcd->config.d5_gpio_dev, lcd->config.d5_pin, (value >> 1) & 0x01);
+    LCD_GPIO_SET(lcd->config.d6_gpio_dev, lcd->config.d6_pin, (value >> 2) & 0x01);
+    LCD_GPIO_SET(lcd->config.d7_gpio_dev, lcd->config.d7_pin, (value >> 3) & 0x01);
+}
+
+/* Drive D4-D7 with one masked write when they share a port */
+static void lcd_set_data_port(lcd_state_t *lcd, uint8_t value)
+{
+    LCD_PORT_SET(lcd->data_port, lcd->data_port_mask, lcd->nibble_port_value[value & 0x0F]);
+}
+
+/* Precompute the port value for every nibble if all data pins are on one port */
+static void lcd_setup_data_port(lcd_state_t *lcd)
+{
+    const lcd_config_t *config = &lcd->config;
+    const gpio_pin_t pins[4] = {config->d4_pin, config->d5_pin, config->d6_pin, config->d7_pin};
+
+    lcd->data_port = NULL;
+
+    if (config->d5_gpio_dev != config->d4_gpio_dev ||
+        config->d6_gpio_dev != config->d4_gpio_dev ||
+        config->d7_gpio_dev != config->d4_gpio_dev) {
+        LOG_INF("LCD data pins span several ports, using per-pin writes");
+        return;
+    }
+
+    /* Pins are configured without GPIO_ACTIVE_LOW, so raw and logical levels match */
+    lcd->data_port_mask = 0;
+    for (int bit = 0; bit < 4; bit++) {
+        lcd->data_port_mask |= BIT(pins[bit]);
+    }
+
+    for (int nibble = 0; nibble < 16; nibble++) {
+        gpio_port_value_t value = 0;
+        for (int bit = 0; bit < 4; bit++) {
+            if (nibble & BIT(bit)) {
+                value |= BIT(pins[bit]);
+            }
+        }
+        lcd->nibble_port_value[nibble] = value;
+    }
+
+    lcd->data_port = config->d4_gpio_dev;
+    LOG_INF("LCD data pins share a port, using masked port writes (mask 0x%08x)",
+            lcd->data_port_mask);
 }
 
 /* Helper function to send 4 bits to the LCD */
 static void lcd_write_4bits(lcd_state_t *lcd, uint8_t value)
 {
-    gpio_pin_set(lcd->config.d4_gpio_dev, lcd->config.d4_pin, (value >> 0) & 0x01);
-    gpio_pin_set(lcd->config.d5_gpio_dev, lcd->config.d5_pin, (value >> 1) & 0x01);
-    gpio_pin_set(lcd->config.d6_gpio_dev, lcd->config.d6_pin, (value >> 2) & 0x01);
-    gpio_pin_set(lcd->config.d7_gpio_dev, lcd->config.d7_pin, (value >> 3) & 0x01);
+    if (lcd->data_port != NULL) {
+        lcd_set_data_port(lcd, value);
+    } else {
+        lcd_set_data_pins(lcd, value);
+    }
 
     lcd_pulse_enable(lcd);
 }
 
+/* Switch D4-D7 between driving the bus and reading it back */
+static void lcd_set_data_direction(lcd_state_t *lcd, gpio_flags_t flags)
+{
+    LCD_GPIO_CONFIGURE(lcd->config.d4_gpio_dev, lcd->config.d4_pin, flags);
+    LCD_GPIO_CONFIGURE(lcd->config.d5_gpio_dev, lcd->config.d5_pin, flags);
+    LCD_GPIO_CONFIGURE(lcd->config.d6_gpio_dev, lcd->config.d6_pin, flags);
+    LCD_GPIO_CONFIGURE(lcd->config.d7_gpio_dev, lcd->config.d7_pin, flags);
+}
+
+/* Poll the busy flag until the controller has finished. Returns false on timeout */
+static bool lcd_poll_busy_flag(lcd_state_t *lcd)
+{
+    bool busy = true;
+    uint32_t start = k_cycle_get_32();
+
+    lcd_set_data_direction(lcd, GPIO_INPUT);
+    LCD_GPIO_SET(lcd->config.rs_gpio_dev, lcd->config.rs_pin, 0);
+    LCD_GPIO_SET(lcd->config.rw_gpio_dev, lcd->config.rw_pin, 1);
+
+    /* Timed on the cycle counter; each poll takes longer than its busy waits because of the
+     * GPIO calls, so counting only the waits would stretch the timeout */
+    while (busy && k_cyc_to_us_floor32(k_cycle_get_32() - start) < LCD_BUSY_TIMEOUT_US) {
+        /* High nibble carries BF on D7 */
+        LCD_GPIO_SET(lcd->config.enable_gpio_dev, lcd->config.enable_pin, 1);
+        LCD_BUSY_WAIT(1);
+        busy = LCD_GPIO_GET(lcd->config.d7_gpio_dev, lcd->config.d7_pin) == 1;
+        LCD_GPIO_SET(lcd->config.enable_gpio_dev, lcd->config.enable_pin, 0);
+        LCD_BUSY_WAIT(1);
+
+        /* Low nibble (address counter) must be clocked out and is ignored */
+        LCD_GPIO_SET(lcd->config.enable_gpio_dev, lcd->config.enable_pin, 1);
+        LCD_BUSY_WAIT(1);
+        LCD_GPIO_SET(lcd->config.enable_gpio_dev, lcd->config.enable_pin, 0);
+        LCD_BUSY_WAIT(1);
+    }
+
+    LCD_GPIO_SET(lcd->config.rw_gpio_dev, lcd->config.rw_pin, 0);
+    lcd_set_data_direction(lcd, GPIO_OUTPUT);
+
+    return !busy;
+}
+
+/* Wait for the byte just sent to execute, polling the busy flag when RW is wired */
+static void lcd_wait_ready(lcd_state_t *lcd, uint16_t exec_us)
+{
+    if (lcd->busy_flag_ready && lcd_poll_busy_flag(lcd)) {
+        return;
+    }
+
+    if (exec_us >= 1000) {
+        LCD_SLEEP_US(exec_us);  /* Long enough to be worth yielding the CPU */
+    } else {
+        LCD_BUSY_WAIT(exec_us);
+    }
+}
+
+/* Execution time of a command byte, based on which instruction it is */
+static uint16_t lcd_command_exec_us(lcd_state_t *lcd, uint8_t command)
+{
+    const lcd_timing_t *timing = &lcd->config.timing;
+
+    if (command & LCD_SETDDRAMADDR) {
+        return timing->ddram_addr_us;
+    }
+    if (command & LCD_SETCGRAMADDR) {
+        return timing->cgram_addr_us;
+    }
+    if (command == LCD_CLEARDISPLAY || (command & ~0x01) == LCD_RETURNHOME) {
+        return timing->clear_home_us;
+    }
+    return timing->ddram_addr_us;
+}
+
 /* Send a command to the LCD */
 static void lcd_send_command(lcd_state_t *lcd, uint8_t command)
 {
-    gpio_pin_set(lcd->config.rs_gpio_dev, lcd->config.rs_pin, 0);
+    LCD_GPIO_SET(lcd->config.rs_gpio_dev, lcd->config.rs_pin, 0);
+    LCD_COUNT_BYTE();
 
     /* Send the high 4 bits */
     lcd_write_4bits(lcd, command >> 4);
 
     /* Send the low 4 bits */
     lcd_write_4bits(lcd, command & 0x0F);
+
+    lcd_wait_ready(lcd, lcd_command_exec_us(lcd, command));
 }
 
 /* Send data to the LCD */
 static void lcd_send_data(lcd_state_t *lcd, uint8_t data)
 {
-    gpio_pin_set(lcd->config.rs_gpio_dev, lcd->config.rs_pin, 1);
+    LCD_GPIO_SET(lcd->config.rs_gpio_dev, lcd->config.rs_pin, 1);
+    LCD_COUNT_BYTE();
 
     /* Send the high 4 bits */
     lcd_write_4bits(lcd, data >> 4);
 
     /* Send the low 4 bits */
     lcd_write_4bits(lcd, data & 0x0F);
+
+    lcd_wait_ready(lcd, lcd->config.timing.data_us);
 }
 
 /* Initialize the LCD with the given configuration */
@@ -71,6 +294,30 @@ int lcd_init(lcd_state_t *lcd, const lcd_config_t *config)
     /* Save configuration */
     memcpy(&lcd->config, config, sizeof(lcd_config_t));
 
+    if (config->rows == 0 || config->rows > LCD_MAX_ROWS) {
+        LOG_ERR("Unsupported number of rows: %u", config->rows);
+        return -EINVAL;
+    }
+
+    /* Fill in datasheet timings for anything the board didn't specify */
+    if (lcd->config.timing.data_us == 0) {
+        lcd->config.timing.data_us = LCD_DEFAULT_DATA_US;
+    }
+    if (lcd->config.timing.ddram_addr_us == 0) {
+        lcd->config.timing.ddram_addr_us = LCD_DEFAULT_DDRAM_ADDR_US;
+    }
+    if (lcd->config.timing.clear_home_us == 0) {
+        lcd->config.timing.clear_home_us = LCD_DEFAULT_CLEAR_HOME_US;
+    }
+    if (lcd->config.timing.cgram_addr_us == 0) {
+        lcd->config.timing.cgram_addr_us = LCD_DEFAULT_CGRAM_ADDR_US;
+    }
+    lcd->busy_flag_ready = false;
+
+    /* Four-line modules fold each 40-cell DDRAM line into two visible rows */
+    lcd->ddram_cols = (config->rows > 2) ? LCD_DDRAM_COLS / 2 : LCD_DDRAM_COLS;
+    lcd->ddram_addr_valid = false;
+
     /* Validate GPIO devices */
     if (!device_is_ready(config->rs_gpio_dev) ||
         !device_is_ready(config->enable_gpio_dev) ||
@@ -121,6 +368,17 @@ int lcd_init(lcd_state_t *lcd, const lcd_config_t *config)
         return ret;
     }
 
+    lcd_setup_data_port(lcd);
+
+    /* Configure RW pin if wired, holding it low (write) except while polling */
+    if (config->rw_pin != 0xFF && config->rw_gpio_dev != NULL) {
+        ret = gpio_pin_configure(config->rw_gpio_dev, config->rw_pin, GPIO_OUTPUT_INACTIVE);
+        if (ret) {
+            LOG_ERR("Failed to configure RW pin: %d", ret);
+            return ret;
+        }
+    }
+
     /* Configure backlight pin if available */
     if (config->backlight_pin != 0xFF && config->backlight_gpio_dev != NULL) {
         ret = gpio_pin_configure(config->backlight_gpio_dev, config->backlight_pin, GPIO_OUTPUT);
@@ -167,11 +425,15 @@ int lcd_init(lcd_state_t *lcd, const lcd_config_t *config)
     /* Fourth write: finally set to 4-bit mode */
     LOG_INF("LCD init step 4: Finally set 4-bit mode");
     lcd_write_4bits(lcd, 0x02);
+    k_busy_wait(lcd->config.timing.ddram_addr_us);
 
     /* Set # of lines, font size, etc. */
     LOG_INF("LCD init: Setting function (lines, font)");
     lcd_send_command(lcd, LCD_FUNCTIONSET | lcd->display_function);
 
+    /* From here on the busy flag is valid */
+    lcd->busy_flag_ready = config->rw_pin != 0xFF && config->rw_gpio_dev != NULL;
+
     /* Turn the display on with no cursor or blinking default */
     lcd->display_control = LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF;
     LOG_INF("LCD init: Setting display control");
@@ -195,14 +457,25 @@ int lcd_init(lcd_state_t *lcd, const lcd_config_t *config)
 void lcd_clear(lcd_state_t *lcd)
 {
     lcd_send_command(lcd, LCD_CLEARDISPLAY);
-    k_msleep(2);  /* Clear takes a long time */
+
+    /* The controller fills DDRAM with spaces and homes the cursor */
+    memset(lcd->shadow, ' ', sizeof(lcd->shadow));
+    memset(lcd->frame, ' ', sizeof(lcd->frame));
+    lcd_mark_clean(lcd);
+    lcd->ddram_addr = 0;
+    lcd->ddram_addr_valid = true;
+    lcd->display_shift = 0;
 }
 
 /* Move cursor to home position */
 void lcd_home(lcd_state_t *lcd)
 {
     lcd_send_command(lcd, LCD_RETURNHOME);
-    k_msleep(2);  /* Return home takes a long time */
+
+    /* Return home also undoes any display shift */
+    lcd->ddram_addr = 0;
+    lcd->ddram_addr_valid = true;
+    lcd->display_shift = 0;
 }
 
 /* Turn on/off the LCD display */
@@ -247,6 +520,20 @@ void lcd_backlight(lcd_state_t *lcd, bool on)
     }
 }
 
+/* Scroll the display one column left */
+void lcd_scroll_display_left(lcd_state_t *lcd)
+{
+    lcd_send_command(lcd, LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVELEFT);
+    lcd->display_shift = (lcd->display_shift + 1) % LCD_DDRAM_COLS;
+}
+
+/* Scroll the display one column right */
+void lcd_scroll_display_right(lcd_state_t *lcd)
+{
+    lcd_send_command(lcd, LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVERIGHT);
+    lcd->display_shift = (lcd->display_shift + LCD_DDRAM_COLS - 1) % LCD_DDRAM_COLS;
+}
+
 /* Set cursor position */
 void lcd_set_cursor(lcd_state_t *lcd, uint8_t row, uint8_t col)
 {
@@ -256,6 +543,9 @@ void lcd_set_cursor(lcd_state_t *lcd, uint8_t row, uint8_t col)
 
     lcd->current_row = row;
     lcd_send_command(lcd, LCD_SETDDRAMADDR | (col + ROW_OFFSETS[row]));
+
+    lcd->ddram_addr = col + ROW_OFFSETS[row];
+    lcd->ddram_addr_valid = true;
 }
 
 /* Write a string to the LCD */
@@ -270,10 +560,11 @@ void lcd_print(lcd_state_t *lcd, const char *str)
 void lcd_write_char(lcd_state_t *lcd, char c)
 {
     lcd_send_data(lcd, c);
+    lcd_shadow_store(lcd, c);
 }
 
 /* Create a custom character (glyph) for use in the LCD */
-void lcd_create_char(lcd_state_t *lcd, uint8_t location, uint8_t charmap[])
+void lcd_create_char(lcd_state_t *lcd, uint8_t location, const uint8_t charmap[])
 {
     location &= 0x7;  /* Only have 8 locations 0-7 */
     lcd_send_command(lcd, LCD_SETCGRAMADDR | (location << 3));
@@ -281,6 +572,74 @@ void lcd_create_char(lcd_state_t *lcd, uint8_t location, uint8_t charmap[])
     for (int i = 0; i < 8; i++) {
         lcd_send_data(lcd, charmap[i]);
     }
+
+    /* The address counter now points into CGRAM */
+    lcd->ddram_addr_valid = false;
+}
+
+/* Clear the frame buffer; the glass is updated on the next flush */
+void lcd_fb_clear(lcd_state_t *lcd)
+{
+    memset(lcd->frame, ' ', sizeof(lcd->frame));
+    for (uint8_t row = 0; row < lcd->config.rows; row++) {
+        lcd_mark_dirty(lcd, row, 0, lcd->ddram_cols - 1);
+    }
+}
+
+/* Place a single character (or custom glyph 0-7) in the frame buffer */
+void lcd_fb_put_char(lcd_state_t *lcd, uint8_t row, uint8_t col, uint8_t c)
+{
+    lcd_fb_write(lcd, row, col, &c, 1);
+}
+
+/* Copy len raw bytes into the frame buffer starting at (row, col) */
+void lcd_fb_write(lcd_state_t *lcd, uint8_t row, uint8_t col, const uint8_t *data, size_t len)
+{
+    if (row >= lcd->config.rows || col >= lcd->ddram_cols || len == 0) {
+        return;
+    }
+
+    /* Anything past the end of the DDRAM line is dropped */
+    len = MIN(len, (size_t)(lcd->ddram_cols - col));
+    memcpy(&lcd->frame[row][col], data, len);
+    lcd_mark_dirty(lcd, row, col, col + len - 1);
+}
+
+/* Copy a string into the frame buffer starting at (row, col) */
+void lcd_fb_print(lcd_state_t *lcd, uint8_t row, uint8_t col, const char *str)
+{
+    lcd_fb_write(lcd, row, col, (const uint8_t *)str, strlen(str));
+}
+
+/* Send only the frame buffer cells that differ from the glass */
+int lcd_flush(lcd_state_t *lcd)
+{
+    int written = 0;
+
+    for (uint8_t row = 0; row < lcd->config.rows; row++) {
+        for (uint16_t col = lcd->dirty_lo[row]; col <= lcd->dirty_hi[row]; col++) {
+            uint8_t c = lcd->frame[row][col];
+            if (c == lcd->shadow[row][col]) {
+                continue;
+            }
+
+            /* Only move the cursor when the changed cell isn't the next one anyway */
+            uint8_t addr = ROW_OFFSETS[row] + col;
+            if (!lcd->ddram_addr_valid || lcd->ddram_addr != addr) {
+                lcd_send_command(lcd, LCD_SETDDRAMADDR | addr);
+                lcd->ddram_addr = addr;
+                lcd->ddram_addr_valid = true;
+            }
+
+            lcd_send_data(lcd, c);
+            lcd->shadow[row][col] = c;
+            lcd_advance_ddram_addr(lcd);
+            written++;
+        }
+    }
+
+    lcd_mark_clean(lcd);
+    return written;
 }
 
 /* Read the current button pressed on the shield */
@@ -294,4 +653,134 @@ lcd_button_t lcd_read_buttons(lcd_state_t *lcd)
     /* ADC configuration not fully implemented yet */
     /* This would need to set up the ADC channel, take a reading, and convert to button value */
     return BUTTON_NONE;
-}
\ No newline at end of file
+}
+
+#ifdef LCD_BENCHMARK
+/* Log the cycle cost of a nibble write on the port-wide and per-pin paths.
+ * Enable is never pulsed, so the controller ignores the data lines meanwhile. */
+void lcd_benchmark_nibble_write(lcd_state_t *lcd, uint32_t iterations)
+{
+    uint32_t start;
+    uint32_t per_pin_cycles;
+    uint32_t port_cycles;
+
+    start = k_cycle_get_32();
+    for (uint32_t i = 0; i < iterations; i++) {
+        lcd_set_data_pins(lcd, i & 0x0F);
+    }
+    per_pin_cycles = k_cycle_get_32() - start;
+
+    if (lcd->data_port == NULL) {
+        LOG_INF("Nibble write: per-pin %u cycles, port path unavailable (split wiring)",
+                per_pin_cycles / iterations);
+        return;
+    }
+
+    start = k_cycle_get_32();
+    for (uint32_t i = 0; i < iterations; i++) {
+        lcd_set_data_port(lcd, i & 0x0F);
+    }
+    port_cycles = k_cycle_get_32() - start;
+
+    LOG_INF("Nibble write: per-pin %u cycles, port %u cycles (%u iterations)",
+            per_pin_cycles / iterations, port_cycles / iterations, iterations);
+}
+
+void lcd_bus_stats_get(lcd_bus_stats_t *stats, bool reset)
+{
+    *stats = bus_stats;
+    if (reset) {
+        memset(&bus_stats, 0, sizeof(bus_stats));
+    }
+}
+
+/* One benchmark operation: run it, then print a CSV row with per-iteration averages */
+static void lcd_benchmark_op(lcd_state_t *lcd, const char *name, uint32_t iterations,
+                             void (*op)(lcd_state_t *lcd, uint32_t i))
+{
+    lcd_bus_stats_t stats;
+    uint32_t cycles = 0;
+
+    lcd_bus_stats_get(&stats, true);
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint32_t start = k_cycle_get_32();
+        op(lcd, i);
+        cycles += k_cycle_get_32() - start;
+    }
+    lcd_bus_stats_get(&stats, true);
+
+    printk("lcd_bench,%s,%u,%u,%u,%u,%u,%u\n", name, iterations,
+           k_cyc_to_us_floor32(cycles) / iterations, stats.busy_wait_us / iterations,
+           stats.sleep_us / iterations, stats.gpio_calls / iterations, stats.bytes / iterations);
+}
+
+/* Two screens with nothing in common, like switching from the clock to the CPU page */
+static const char *const bench_pages[2][2] = {
+    {"   03/14/2025   ", "    08:28 PM    "},
+    {"\x01 67C     \x03 35%", "      \x02 39%     "},
+};
+
+static void bench_full_redraw_direct(lcd_state_t *lcd, uint32_t i)
+{
+    lcd_clear(lcd);
+    lcd_set_cursor(lcd, 0, 0);
+    lcd_print(lcd, bench_pages[i & 1][0]);
+    lcd_set_cursor(lcd, 1, 0);
+    lcd_print(lcd, bench_pages[i & 1][1]);
+}
+
+static void bench_page_switch(lcd_state_t *lcd, uint32_t i)
+{
+    lcd_fb_print(lcd, 0, 0, bench_pages[i & 1][0]);
+    lcd_fb_print(lcd, 1, 0, bench_pages[i & 1][1]);
+    lcd_flush(lcd);
+}
+
+static void bench_digit_update_direct(lcd_state_t *lcd, uint32_t i)
+{
+    lcd_set_cursor(lcd, 0, 12);
+    lcd_write_char(lcd, '0' + i % 10);
+}
+
+static void bench_digit_update(lcd_state_t *lcd, uint32_t i)
+{
+    lcd_fb_put_char(lcd, 0, 12, '0' + i % 10);
+    lcd_flush(lcd);
+}
+
+static void bench_unchanged_flush(lcd_state_t *lcd, uint32_t i)
+{
+    lcd_flush(lcd);
+}
+
+/* Rewrites CGRAM slot 7. The glyph manager owns all eight slots and doesn't know about this
+ * write, so it is only safe because the benchmarks run at boot, before the first render loads
+ * any glyph */
+static void bench_glyph_upload(lcd_state_t *lcd, uint32_t i)
+{
+    uint8_t glyph[8];
+
+    memset(glyph, i & 0x1F, sizeof(glyph));
+    lcd_create_char(lcd, 7, glyph);
+}
+
+static void bench_clear(lcd_state_t *lcd, uint32_t i)
+{
+    lcd_clear(lcd);
+}
+
+void lcd_benchmark_workload(lcd_state_t *lcd, uint32_t iterations)
+{
+    /* Averages per iteration; wall time includes the waits */
+    printk("lcd_bench,op,iterations,wall_us,busy_wait_us,sleep_us,gpio_calls,bytes\n");
+
+    lcd_benchmark_op(lcd, "full_redraw_direct", iterations, bench_full_redraw_direct);
+    lcd_clear(lcd);
+    lcd_benchmark_op(lcd, "page_switch", iterations, bench_page_switch);
+    lcd_benchmark_op(lcd, "digit_update_direct", iterations, bench_digit_update_direct);
+    lcd_benchmark_op(lcd, "digit_update", iterations, bench_digit_update);
+    lcd_benchmark_op(lcd, "unchanged_flush", iterations, bench_unchanged_flush);
+    lcd_benchmark_op(lcd, "glyph_upload", iterations, bench_glyph_upload);
+    lcd_benchmark_op(lcd, "clear", iterations, bench_clear);
+}
+#endif
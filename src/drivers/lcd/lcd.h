@@ -26,6 +26,12 @@
 #define LCD_ENTRY_SHIFT_INC 0x01
 #define LCD_ENTRY_SHIFT_DEC 0x00
 
+/* Cursor/display shift flags */
+#define LCD_DISPLAYMOVE     0x08
+#define LCD_CURSORMOVE      0x00
+#define LCD_MOVERIGHT       0x04
+#define LCD_MOVELEFT        0x00
+
 /* Display control flags */
 #define LCD_DISPLAYON       0x04
 #define LCD_DISPLAYOFF      0x00
@@ -42,6 +48,11 @@
 #define LCD_5x10DOTS        0x04
 #define LCD_5x8DOTS         0x00
 
+/* Frame buffer geometry. Each DDRAM line is 40 cells wide no matter how many
+ * columns are visible; four-line modules split those lines in half. */
+#define LCD_MAX_ROWS        4
+#define LCD_DDRAM_COLS      40
+
 /* Button values (approximate ADC readings) */
 #define BUTTON_RIGHT_ADC    0
 #define BUTTON_UP_ADC       1
@@ -50,65 +61,14 @@
 #define BUTTON_SELECT_ADC   4
 #define BUTTON_NONE_ADC     5
 
-/* Temperature symbol - thermometer */
-static uint8_t temperature_char[] = {
-    0x0E,  /* 01110 */
-    0x0A,  /* 01010 */
-    0x0A,  /* 01010 */
-    0x0E,  /* 01110 */
-    0x0E,  /* 01110 */
-    0x1F,  /* 11111 */
-    0x1F,  /* 11111 */
-    0x0E   /* 01110 */
-};
-
-/* Fan symbol - frame 1 (for animation) */
-static uint8_t fan_char1[] = {
-    0x00,  /* 00000 */
-    0x0E,  /* 01110 */
-    0x13,  /* 10011 */
-    0x15,  /* 10101 */
-    0x19,  /* 11001 */
-    0x0E,  /* 01110 */
-    0x00,  /* 00000 */
-    0x00   /* 00000 */
-};
-
-/* Fan symbol - frame 2 (for animation) */
-static uint8_t fan_char2[] = {
-    0x00,  /* 00000 */
-    0x0E,  /* 01110 */
-    0x19,  /* 11001 */
-    0x15,  /* 10101 */
-    0x13,  /* 10011 */
-    0x0E,  /* 01110 */
-    0x00,  /* 00000 */
-    0x00   /* 00000 */
-};
-
-/* CPU symbol */
-static uint8_t cpu_char[] = {
-    0x18,  /* 11000 */
-    0x10,  /* 10000 */
-    0x1B,  /* 11011 */
-    0x03,  /* 00011 */
-    0x02,  /* 00010 */
-    0x02,  /* 00010 */
-    0x14,  /* 10100 */
-    0x1C   /* 11100 */
-};
-
-/* Memory/RAM symbol */
-static uint8_t memory_char[] = {
-    0x0E,  /* 01110 */
-    0x0B,  /* 01011 */
-    0x0E,  /* 01110 */
-    0x0F,  /* 01111 */
-    0x0A,  /* 01010 */
-    0x0F,  /* 01111 */
-    0x0A,  /* 01010 */
-    0x0F   /* 01111 */
-};
+/* Execution time in microseconds for each class of controller operation.
+ * Fields left at zero fall back to the datasheet worst case. */
+typedef struct {
+    uint16_t data_us;         /* DDRAM/CGRAM data write */
+    uint16_t ddram_addr_us;   /* Set DDRAM address and the other short instructions */
+    uint16_t clear_home_us;   /* Clear display and return home */
+    uint16_t cgram_addr_us;   /* Set CGRAM address */
+} lcd_timing_t;
 
 /* Possible button values */
 typedef enum {
@@ -129,6 +89,10 @@ typedef struct {
     const struct device *enable_gpio_dev;
     gpio_pin_t enable_pin;
 
+    /* RW pin, or 0xFF when tied to ground. When wired, the busy flag is polled */
+    const struct device *rw_gpio_dev;
+    gpio_pin_t rw_pin;
+
     const struct device *d4_gpio_dev;
     gpio_pin_t d4_pin;
 
@@ -151,6 +115,9 @@ typedef struct {
     /* Display dimensions */
     uint8_t cols;
     uint8_t rows;
+
+    /* Controller execution times */
+    lcd_timing_t timing;
 } lcd_config_t;
 
 /* LCD state structure */
@@ -161,6 +128,30 @@ typedef struct {
     uint8_t display_mode;
     uint8_t current_row;
     uint8_t backlight_state;
+
+    /* Shadow of what is on the glass, and the frame waiting to be flushed */
+    uint8_t shadow[LCD_MAX_ROWS][LCD_DDRAM_COLS];
+    uint8_t frame[LCD_MAX_ROWS][LCD_DDRAM_COLS];
+    uint8_t ddram_cols;
+
+    /* Per-row range of frame cells touched since the last flush (lo > hi when clean) */
+    uint8_t dirty_lo[LCD_MAX_ROWS];
+    uint8_t dirty_hi[LCD_MAX_ROWS];
+
+    /* Controller address counter, valid only while it points into DDRAM */
+    uint8_t ddram_addr;
+    bool ddram_addr_valid;
+
+    /* DDRAM column shown in the first visible column, moved by display shift commands */
+    uint8_t display_shift;
+
+    /* Set when D4-D7 share one port; each nibble is then a single masked port write */
+    const struct device *data_port;
+    gpio_port_pins_t data_port_mask;
+    gpio_port_value_t nibble_port_value[16];
+
+    /* Busy flag can only be read once the controller is in 4-bit mode */
+    bool busy_flag_ready;
 } lcd_state_t;
 
 /* Initialize the LCD with the given configuration */
@@ -184,6 +175,11 @@ void lcd_blink(lcd_state_t *lcd, bool on);
 /* Turn on/off the LCD backlight */
 void lcd_backlight(lcd_state_t *lcd, bool on);
 
+/* Move the visible window one column along DDRAM with a single command; DDRAM is untouched.
+ * Left scrolls the text left, bringing the columns past the right edge into view */
+void lcd_scroll_display_left(lcd_state_t *lcd);
+void lcd_scroll_display_right(lcd_state_t *lcd);
+
 /* Set cursor position */
 void lcd_set_cursor(lcd_state_t *lcd, uint8_t row, uint8_t col);
 
@@ -194,9 +190,44 @@ void lcd_print(lcd_state_t *lcd, const char *str);
 void lcd_write_char(lcd_state_t *lcd, char c);
 
 /* Create a custom character (glyph) for use in the LCD */
-void lcd_create_char(lcd_state_t *lcd, uint8_t location, uint8_t charmap[]);
+void lcd_create_char(lcd_state_t *lcd, uint8_t location, const uint8_t charmap[]);
+
+/* Clear the frame buffer; the glass is updated on the next flush */
+void lcd_fb_clear(lcd_state_t *lcd);
+
+/* Place a single character (or custom glyph 0-7) in the frame buffer */
+void lcd_fb_put_char(lcd_state_t *lcd, uint8_t row, uint8_t col, uint8_t c);
+
+/* Copy len raw bytes into the frame buffer starting at (row, col) */
+void lcd_fb_write(lcd_state_t *lcd, uint8_t row, uint8_t col, const uint8_t *data, size_t len);
+
+/* Copy a string into the frame buffer starting at (row, col) */
+void lcd_fb_print(lcd_state_t *lcd, uint8_t row, uint8_t col, const char *str);
+
+/* Send only the frame buffer cells that differ from the glass. Returns the number of cells written */
+int lcd_flush(lcd_state_t *lcd);
 
 /* Read the current button pressed on the shield */
 lcd_button_t lcd_read_buttons(lcd_state_t *lcd);
 
+#ifdef LCD_BENCHMARK
+/* Bus activity since the counters were last reset */
+typedef struct {
+    uint32_t gpio_calls;
+    uint32_t busy_wait_us;
+    uint32_t sleep_us;
+    uint32_t bytes;         /* Commands and data bytes sent */
+} lcd_bus_stats_t;
+
+void lcd_bus_stats_get(lcd_bus_stats_t *stats, bool reset);
+
+/* Log the cycle cost of a nibble write on the port-wide and per-pin paths */
+void lcd_benchmark_nibble_write(lcd_state_t *lcd, uint32_t iterations);
+
+/* Time a fixed set of driver operations and print one CSV row per operation on the console,
+ * prefixed "lcd_bench," so the rows can be grepped out of the log. Overwrites DDRAM and CGRAM,
+ * so it must run before display_init */
+void lcd_benchmark_workload(lcd_state_t *lcd, uint32_t iterations);
+#endif
+
 #endif /* LCD_H */
\ No newline at end of file
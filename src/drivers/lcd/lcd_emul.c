@@ -0,0 +1,211 @@
+/*
+ * Emulated HD44780 controller for builds on the emulated GPIO port (native_sim)
+ */
+
+#include "lcd_emul.h"
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include <zephyr/logging/log.h>
+#include <string.h>
+
+LOG_MODULE_REGISTER(lcd_emul, LOG_LEVEL_INF);
+
+#define EMUL_DDRAM_SIZE 0x80
+#define EMUL_CGRAM_SIZE 0x40
+
+/* Second DDRAM line in two-line mode */
+#define EMUL_LINE2 0x40
+
+static struct {
+    uint8_t ddram[EMUL_DDRAM_SIZE];
+    uint8_t cgram[EMUL_CGRAM_SIZE];
+    uint8_t addr;               /* Address counter */
+    bool addr_is_cgram;         /* Last address set was a CGRAM address */
+    bool four_bit;              /* Function set chose a 4-bit bus */
+    bool two_line;
+    bool have_high_nibble;      /* 4-bit mode: first half of a byte received */
+    uint8_t high_nibble;
+    bool increment;             /* Entry mode I/D */
+    bool entry_shift;           /* Entry mode S */
+    uint8_t shift;              /* Display shift, 0..LCD_DDRAM_COLS - 1 */
+    lcd_emul_stats_t stats;
+} emul = {
+    .increment = true,
+};
+
+static struct k_spinlock emul_lock;
+
+static uint8_t emul_line_base(uint8_t addr)
+{
+    return (emul.two_line && addr >= EMUL_LINE2) ? EMUL_LINE2 : 0x00;
+}
+
+/* Move the address counter one step, wrapping between DDRAM lines like the controller */
+static void emul_step_addr(void)
+{
+    if (emul.addr_is_cgram) {
+        emul.addr = (emul.addr + (emul.increment ? 1 : -1)) & (EMUL_CGRAM_SIZE - 1);
+        return;
+    }
+
+    if (!emul.two_line) {
+        /* One 80-cell line */
+        emul.addr = (emul.addr + (emul.increment ? 1 : 0x50 - 1)) % 0x50;
+        return;
+    }
+
+    uint8_t base = emul_line_base(emul.addr);
+    uint8_t offset = emul.addr - base;
+    if (emul.increment) {
+        if (++offset == LCD_DDRAM_COLS) {
+            base ^= EMUL_LINE2;
+            offset = 0;
+        }
+    } else {
+        if (offset-- == 0) {
+            base ^= EMUL_LINE2;
+            offset = LCD_DDRAM_COLS - 1;
+        }
+    }
+    emul.addr = base + offset;
+}
+
+static void emul_shift_display(bool right)
+{
+    emul.shift = (emul.shift + (right ? LCD_DDRAM_COLS - 1 : 1)) % LCD_DDRAM_COLS;
+}
+
+static void emul_command(uint8_t cmd)
+{
+    emul.stats.commands++;
+
+    if (cmd & LCD_SETDDRAMADDR) {
+        emul.addr = cmd & 0x7F;
+        emul.addr_is_cgram = false;
+        emul.stats.addr_sets++;
+    } else if (cmd & LCD_SETCGRAMADDR) {
+        emul.addr = cmd & 0x3F;
+        emul.addr_is_cgram = true;
+        emul.stats.addr_sets++;
+    } else if (cmd & LCD_FUNCTIONSET) {
+        emul.four_bit = !(cmd & LCD_8BITMODE);
+        emul.two_line = cmd & LCD_2LINE;
+    } else if (cmd & LCD_CURSORSHIFT) {
+        /* S/C selects display shift over cursor move, R/L the direction */
+        if (cmd & 0x08) {
+            emul_shift_display(cmd & 0x04);
+        } else {
+            bool increment = emul.increment;
+            emul.increment = cmd & 0x04;
+            emul_step_addr();
+            emul.increment = increment;
+        }
+    } else if (cmd & LCD_DISPLAYCONTROL) {
+        /* Display, cursor and blink state don't change the image */
+    } else if (cmd & LCD_ENTRYMODESET) {
+        emul.increment = cmd & LCD_ENTRY_LEFT;
+        emul.entry_shift = cmd & LCD_ENTRY_SHIFT_INC;
+    } else if (cmd & LCD_RETURNHOME) {
+        emul.addr = 0;
+        emul.addr_is_cgram = false;
+        emul.shift = 0;
+        emul.stats.clears++;
+    } else if (cmd & LCD_CLEARDISPLAY) {
+        memset(emul.ddram, ' ', sizeof(emul.ddram));
+        emul.addr = 0;
+        emul.addr_is_cgram = false;
+        emul.shift = 0;
+        emul.increment = true;
+        emul.stats.clears++;
+    }
+}
+
+static void emul_data(uint8_t data)
+{
+    emul.stats.data_writes++;
+
+    if (emul.addr_is_cgram) {
+        emul.cgram[emul.addr] = data & 0x1F;
+    } else {
+        emul.ddram[emul.addr] = data;
+        if (emul.entry_shift) {
+            emul_shift_display(!emul.increment);
+        }
+    }
+    emul_step_addr();
+}
+
+void lcd_emul_latch(const lcd_config_t *config)
+{
+    bool rs = gpio_emul_output_get(config->rs_gpio_dev, config->rs_pin) == 1;
+    uint8_t nibble = (gpio_emul_output_get(config->d4_gpio_dev, config->d4_pin) == 1 ? 0x1 : 0) |
+                     (gpio_emul_output_get(config->d5_gpio_dev, config->d5_pin) == 1 ? 0x2 : 0) |
+                     (gpio_emul_output_get(config->d6_gpio_dev, config->d6_pin) == 1 ? 0x4 : 0) |
+                     (gpio_emul_output_get(config->d7_gpio_dev, config->d7_pin) == 1 ? 0x8 : 0);
+    uint8_t byte;
+
+    k_spinlock_key_t key = k_spin_lock(&emul_lock);
+    emul.stats.strobes++;
+
+    if (!emul.four_bit) {
+        /* 8-bit mode with D0-D3 not connected: only the high nibble carries information */
+        byte = nibble << 4;
+    } else if (!emul.have_high_nibble) {
+        emul.high_nibble = nibble;
+        emul.have_high_nibble = true;
+        k_spin_unlock(&emul_lock, key);
+        return;
+    } else {
+        byte = (emul.high_nibble << 4) | nibble;
+        emul.have_high_nibble = false;
+    }
+
+    if (rs) {
+        emul_data(byte);
+    } else {
+        emul_command(byte);
+    }
+    k_spin_unlock(&emul_lock, key);
+}
+
+void lcd_emul_stats_get(lcd_emul_stats_t *stats)
+{
+    k_spinlock_key_t key = k_spin_lock(&emul_lock);
+    *stats = emul.stats;
+    k_spin_unlock(&emul_lock, key);
+}
+
+uint8_t lcd_emul_visible_char(uint8_t row, uint8_t col)
+{
+    static const uint8_t row_base[LCD_MAX_ROWS] = {0x00, 0x40, 0x14, 0x54};
+
+    if (row >= LCD_MAX_ROWS) {
+        return ' ';
+    }
+
+    /* Rows 2 and 3 of four-line modules continue lines 0 and 1 half way along */
+    uint8_t line = row_base[row] & EMUL_LINE2;
+    uint8_t offset = (row_base[row] - line + col + emul.shift) % LCD_DDRAM_COLS;
+    return emul.ddram[line + offset];
+}
+
+void lcd_emul_log(uint8_t rows, uint8_t cols)
+{
+    lcd_emul_stats_t stats;
+    char text[LCD_DDRAM_COLS + 1];
+
+    lcd_emul_stats_get(&stats);
+    LOG_INF("Bus: %u strobes, %u commands (%u address sets, %u clears), %u data writes",
+            stats.strobes, stats.commands, stats.addr_sets, stats.clears, stats.data_writes);
+
+    cols = MIN(cols, LCD_DDRAM_COLS);
+    for (uint8_t row = 0; row < rows; row++) {
+        for (uint8_t col = 0; col < cols; col++) {
+            uint8_t c = lcd_emul_visible_char(row, col);
+            /* Custom glyphs show as their slot number */
+            text[col] = c < 0x08 ? '0' + c : (c >= 0x20 && c < 0x7F ? c : '?');
+        }
+        text[cols] = '\0';
+        LOG_INF("Row %u: |%s|", row, text);
+    }
+}
@@ -0,0 +1,36 @@
+/*
+ * Emulated HD44780 controller for builds on the emulated GPIO port (native_sim)
+ *
+ * The driver calls lcd_emul_latch() on every falling edge of Enable. The model
+ * samples RS and D4-D7 from the emulated GPIO outputs, assembles nibbles the way
+ * the real controller does (8-bit mode until function set selects 4 bits) and
+ * applies the result to its own DDRAM/CGRAM image.
+ */
+
+#ifndef LCD_EMUL_H
+#define LCD_EMUL_H
+
+#include "lcd.h"
+
+/* Bus activity seen by the model since boot */
+typedef struct {
+    uint32_t strobes;       /* Enable pulses, i.e. bus cycles */
+    uint32_t commands;
+    uint32_t data_writes;
+    uint32_t addr_sets;     /* SETDDRAMADDR and SETCGRAMADDR commands */
+    uint32_t clears;        /* CLEARDISPLAY and RETURNHOME commands */
+} lcd_emul_stats_t;
+
+/* Latch the bus state on the falling edge of Enable */
+void lcd_emul_latch(const lcd_config_t *config);
+
+/* Copy of the bus counters */
+void lcd_emul_stats_get(lcd_emul_stats_t *stats);
+
+/* Visible character at (row, col), taking the display shift into account */
+uint8_t lcd_emul_visible_char(uint8_t row, uint8_t col);
+
+/* Log the counters and what is currently on the emulated glass */
+void lcd_emul_log(uint8_t rows, uint8_t cols);
+
+#endif /* LCD_EMUL_H */
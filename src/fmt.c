@@ -0,0 +1,145 @@
+/*
+ * Fixed-width text formatters for the display
+ */
+
+#include "fmt.h"
+#include <string.h>
+
+#ifdef FMT_BENCHMARK
+#include <stdio.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(fmt, LOG_LEVEL_INF);
+#endif
+
+/* Write value as exactly digits decimal digits, zero-padded */
+static void fmt_digits(char *out, uint8_t digits, uint32_t value)
+{
+    for (int i = digits - 1; i >= 0; i--) {
+        out[i] = '0' + value % 10;
+        value /= 10;
+    }
+}
+
+void fmt_uint_suffix(char *out, uint8_t width, uint32_t value, const char *suffix)
+{
+    size_t suffix_len = strlen(suffix);
+    char *end = out + width;
+
+    if (suffix_len > width) {
+        memset(out, '-', width);
+        return;
+    }
+
+    end -= suffix_len;
+    memcpy(end, suffix, suffix_len);
+
+    char *p = end;
+    do {
+        if (p == out) {
+            /* Does not fit */
+            memset(out, '-', end - out);
+            return;
+        }
+        *--p = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+
+    memset(out, ' ', p - out);
+}
+
+void fmt_uint(char *out, uint8_t width, uint32_t value)
+{
+    fmt_uint_suffix(out, width, value, "");
+}
+
+void fmt_clock(char *out, uint8_t hour, uint8_t minute, bool pm)
+{
+    fmt_digits(out, 2, hour);
+    out[2] = ':';
+    fmt_digits(out + 3, 2, minute);
+    out[5] = ' ';
+    out[6] = pm ? 'P' : 'A';
+    out[7] = 'M';
+}
+
+void fmt_date(char *out, uint8_t month, uint8_t day, uint16_t year)
+{
+    fmt_digits(out, 2, month);
+    out[2] = '/';
+    fmt_digits(out + 3, 2, day);
+    out[5] = '/';
+    fmt_digits(out + 6, 4, year);
+}
+
+void fmt_text(char *out, uint8_t width, const uint8_t *text, size_t len)
+{
+    size_t n = len < width ? len : width;
+
+    /* Codes below 0x20 would show as custom characters or glyph model codes, and 0x7F isn't
+     * ASCII on the LCD */
+    for (size_t i = 0; i < n; i++) {
+        out[i] = (text[i] < 0x20 || text[i] == 0x7F) ? ' ' : text[i];
+    }
+    memset(out + n, ' ', width - n);
+}
+
+#ifdef FMT_BENCHMARK
+/* Fold a formatted field into a checksum, so the optimizer can't drop the formatting */
+static uint32_t fmt_fold(uint32_t sum, const char *out, uint8_t width)
+{
+    for (uint8_t i = 0; i < width; i++) {
+        sum = sum * 31 + (uint8_t)out[i];
+    }
+    return sum;
+}
+
+void fmt_benchmark(uint32_t iterations)
+{
+    char out[16];
+    uint32_t start;
+    uint32_t fmt_cycles;
+    uint32_t snprintf_cycles;
+    uint32_t fmt_sum = 0;
+    uint32_t snprintf_sum = 0;
+
+    /* snprintf writes less than the field width for short values */
+    memset(out, ' ', sizeof(out));
+
+    /* One pass formats what a full batch of metrics needs. Both loops fold the same widths */
+    start = k_cycle_get_32();
+    for (uint32_t i = 0; i < iterations; i++) {
+        fmt_date(out, 3, 25, 2025);
+        fmt_sum = fmt_fold(fmt_sum, out, FMT_DATE_WIDTH);
+        fmt_clock(out, 10, i % 60, true);
+        fmt_sum = fmt_fold(fmt_sum, out, FMT_CLOCK_WIDTH);
+        fmt_uint_suffix(out, 4, i % 101, "C");
+        fmt_sum = fmt_fold(fmt_sum, out, 4);
+        fmt_uint_suffix(out, 4, i % 101, "%");
+        fmt_sum = fmt_fold(fmt_sum, out, 4);
+        fmt_uint_suffix(out, 8, i % 4000, "RPM");
+        fmt_sum = fmt_fold(fmt_sum, out, 8);
+    }
+    fmt_cycles = k_cycle_get_32() - start;
+
+    start = k_cycle_get_32();
+    for (uint32_t i = 0; i < iterations; i++) {
+        snprintf(out, sizeof(out), "%02u/%02u/%u", 3, 25, 2025);
+        snprintf_sum = fmt_fold(snprintf_sum, out, FMT_DATE_WIDTH);
+        snprintf(out, sizeof(out), "%02u:%02u %s", 10, i % 60, "PM");
+        snprintf_sum = fmt_fold(snprintf_sum, out, FMT_CLOCK_WIDTH);
+        snprintf(out, sizeof(out), "%uC", i % 101);
+        snprintf_sum = fmt_fold(snprintf_sum, out, 4);
+        snprintf(out, sizeof(out), "%02u%%", i % 101);
+        snprintf_sum = fmt_fold(snprintf_sum, out, 4);
+        snprintf(out, sizeof(out), "%uRPM", i % 4000);
+        snprintf_sum = fmt_fold(snprintf_sum, out, 8);
+    }
+    snprintf_cycles = k_cycle_get_32() - start;
+
+    LOG_INF("Metric formatting: fmt %u cycles, snprintf %u cycles per 5-metric update (%u iterations)",
+            fmt_cycles / iterations, snprintf_cycles / iterations, iterations);
+    LOG_INF("Checksums: fmt %08x, snprintf %08x", fmt_sum, snprintf_sum);
+}
+#endif
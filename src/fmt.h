@@ -0,0 +1,40 @@
+/*
+ * Fixed-width text formatters for the display
+ *
+ * Each formatter fills exactly the number of cells it is given, without a NUL terminator, so the
+ * result can be copied straight into a display buffer and always overwrites the previous value.
+ * Numbers are right-aligned; a value too wide for its field is shown as dashes.
+ */
+
+#ifndef FMT_H
+#define FMT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Fixed-width fields */
+#define FMT_CLOCK_WIDTH 8   /* HH:MM AM */
+#define FMT_DATE_WIDTH 10   /* MM/DD/YYYY */
+
+/* Right-align value in width cells, padded with spaces */
+void fmt_uint(char *out, uint8_t width, uint32_t value);
+
+/* Right-align value followed by suffix ("%", "C", "RPM", ...) in width cells */
+void fmt_uint_suffix(char *out, uint8_t width, uint32_t value, const char *suffix);
+
+/* 12-hour clock, "HH:MM AM" */
+void fmt_clock(char *out, uint8_t hour, uint8_t minute, bool pm);
+
+/* "MM/DD/YYYY" */
+void fmt_date(char *out, uint8_t month, uint8_t day, uint16_t year);
+
+/* Left-align up to width characters of text, padded with spaces. Control codes become spaces */
+void fmt_text(char *out, uint8_t width, const uint8_t *text, size_t len);
+
+#ifdef FMT_BENCHMARK
+/* Log cycles per metric update for these formatters against snprintf */
+void fmt_benchmark(uint32_t iterations);
+#endif
+
+#endif /* FMT_H */
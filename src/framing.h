@@ -0,0 +1,25 @@
+/*
+ * COBS framing and CRC-8 helpers for the host link
+ */
+
+#ifndef FRAMING_H
+#define FRAMING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Worst-case size of n bytes after COBS encoding, not counting the 0x00 delimiter */
+#define COBS_MAX_ENCODED_LEN(n) ((n) + ((n) / 254) + 1)
+
+/* CRC-8 with polynomial 0x07 and initial value 0x00 (CRC-8/SMBUS), one table lookup per byte */
+uint8_t crc8(const uint8_t *data, size_t len);
+
+/* COBS-encode len bytes from src into dst, which must hold COBS_MAX_ENCODED_LEN(len).
+ * Returns the encoded length; the output contains no 0x00 bytes */
+size_t cobs_encode(const uint8_t *src, size_t len, uint8_t *dst);
+
+/* Decode a COBS block (without its delimiter) into dst, which may alias src.
+ * Returns the decoded length, or 0 if the block is malformed */
+size_t cobs_decode(const uint8_t *src, size_t len, uint8_t *dst);
+
+#endif /* FRAMING_H */
@@ -0,0 +1,347 @@
+/*
+ * Custom glyph manager: owns the eight CGRAM slots of the LCD
+ *
+ * Glyphs are loaded the first time a render pass needs them. When all slots
+ * are taken, the slot least recently shown is reused, but never one mapped in
+ * the current pass, so a page can show up to GLYPH_SLOTS glyphs at once.
+ * An animated glyph is advanced, and a changed dynamic glyph reloaded, only
+ * while it was shown in the last pass; otherwise it is brought up to date
+ * when next mapped.
+ */
+
+#include "glyphs.h"
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <string.h>
+
+LOG_MODULE_REGISTER(glyphs, LOG_LEVEL_INF);
+
+/* Glyph ids are model codes, which must stay below the printable range */
+BUILD_ASSERT(GLYPH_CODE(GLYPH_COUNT) <= 0x20, "Too many glyphs for the model code range");
+
+/* Marks an empty slot, or a glyph that isn't loaded */
+#define GLYPH_NONE      0xFF
+
+/* Every custom bitmap, top row first, using the low five bits of each byte */
+enum {
+    BITMAP_TEMPERATURE,
+    BITMAP_MEMORY,
+    BITMAP_CPU,
+    BITMAP_FAN_1,
+    BITMAP_FAN_2,
+    BITMAP_BAR_1,
+    BITMAP_BAR_2,
+    BITMAP_BAR_3,
+    BITMAP_BAR_4,
+};
+
+/* Bitmaps of the dynamic glyphs */
+enum {
+    DYNAMIC_SPARK_CPU_0,
+    DYNAMIC_SPARK_CPU_1,
+    DYNAMIC_SPARK_GPU_0,
+    DYNAMIC_SPARK_GPU_1,
+    DYNAMIC_COUNT
+};
+
+/* Every row of a bar cell is the same; the ROM full block is 8 rows high too */
+#define BAR_BITMAP(columns) { [0 ... GLYPH_HEIGHT - 1] = (0x1F << (GLYPH_WIDTH - (columns))) & 0x1F }
+
+static const uint8_t glyph_bitmaps[][GLYPH_HEIGHT] = {
+    /* Thermometer */
+    [BITMAP_TEMPERATURE] = {
+        0x0E,  /* 01110 */
+        0x0A,  /* 01010 */
+        0x0A,  /* 01010 */
+        0x0E,  /* 01110 */
+        0x0E,  /* 01110 */
+        0x1F,  /* 11111 */
+        0x1F,  /* 11111 */
+        0x0E   /* 01110 */
+    },
+    /* Memory module */
+    [BITMAP_MEMORY] = {
+        0x0E,  /* 01110 */
+        0x0B,  /* 01011 */
+        0x0E,  /* 01110 */
+        0x0F,  /* 01111 */
+        0x0A,  /* 01010 */
+        0x0F,  /* 01111 */
+        0x0A,  /* 01010 */
+        0x0F   /* 01111 */
+    },
+    /* CPU */
+    [BITMAP_CPU] = {
+        0x18,  /* 11000 */
+        0x10,  /* 10000 */
+        0x1B,  /* 11011 */
+        0x03,  /* 00011 */
+        0x02,  /* 00010 */
+        0x02,  /* 00010 */
+        0x14,  /* 10100 */
+        0x1C   /* 11100 */
+    },
+    /* Fan, two frames a quarter turn apart */
+    [BITMAP_FAN_1] = {
+        0x00,  /* 00000 */
+        0x0E,  /* 01110 */
+        0x13,  /* 10011 */
+        0x15,  /* 10101 */
+        0x19,  /* 11001 */
+        0x0E,  /* 01110 */
+        0x00,  /* 00000 */
+        0x00   /* 00000 */
+    },
+    [BITMAP_FAN_2] = {
+        0x00,  /* 00000 */
+        0x0E,  /* 01110 */
+        0x19,  /* 11001 */
+        0x15,  /* 10101 */
+        0x13,  /* 10011 */
+        0x0E,  /* 01110 */
+        0x00,  /* 00000 */
+        0x00   /* 00000 */
+    },
+    [BITMAP_BAR_1] = BAR_BITMAP(1),
+    [BITMAP_BAR_2] = BAR_BITMAP(2),
+    [BITMAP_BAR_3] = BAR_BITMAP(3),
+    [BITMAP_BAR_4] = BAR_BITMAP(4),
+};
+
+/* Consecutive bitmaps making up each glyph; more than one frame makes it animatable.
+ * No frames means a dynamic glyph, and first indexes dynamic_bitmaps */
+typedef struct {
+    uint8_t first;
+    uint8_t frames;
+} glyph_def_t;
+
+static const glyph_def_t glyph_defs[GLYPH_COUNT] = {
+    [GLYPH_TEMPERATURE] = { BITMAP_TEMPERATURE,  1 },
+    [GLYPH_MEMORY]      = { BITMAP_MEMORY,       1 },
+    [GLYPH_CPU]         = { BITMAP_CPU,          1 },
+    [GLYPH_FAN]         = { BITMAP_FAN_1,        2 },
+    [GLYPH_BAR_1]       = { BITMAP_BAR_1,        1 },
+    [GLYPH_BAR_2]       = { BITMAP_BAR_2,        1 },
+    [GLYPH_BAR_3]       = { BITMAP_BAR_3,        1 },
+    [GLYPH_BAR_4]       = { BITMAP_BAR_4,        1 },
+    [GLYPH_SPARK_CPU_0] = { DYNAMIC_SPARK_CPU_0, 0 },
+    [GLYPH_SPARK_CPU_1] = { DYNAMIC_SPARK_CPU_1, 0 },
+    [GLYPH_SPARK_GPU_0] = { DYNAMIC_SPARK_GPU_0, 0 },
+    [GLYPH_SPARK_GPU_1] = { DYNAMIC_SPARK_GPU_1, 0 },
+};
+
+/* What each CGRAM slot holds. Render thread only */
+typedef struct {
+    uint8_t glyph;          /* glyph_id_t, or GLYPH_NONE when empty */
+    uint32_t last_used;     /* Render pass that last mapped it */
+} glyph_slot_t;
+
+static glyph_slot_t slots[GLYPH_SLOTS] = {
+    [0 ... GLYPH_SLOTS - 1] = { .glyph = GLYPH_NONE },
+};
+static uint8_t glyph_slot[GLYPH_COUNT] = {
+    [0 ... GLYPH_COUNT - 1] = GLYPH_NONE,
+};
+
+/* Current render pass; starts at 1 so a slot never used doesn't look like part of it */
+static uint32_t pass = 1;
+static bool overflow_logged;
+
+/* Animation settings and dynamic bitmaps, guarded by anim_lock. A glyph is stale when its
+ * bitmap changed after it was last written to CGRAM */
+static struct k_spinlock anim_lock;
+static uint16_t frame_ms[GLYPH_COUNT];
+static int64_t frame_due[GLYPH_COUNT];
+static uint8_t dynamic_bitmaps[DYNAMIC_COUNT][GLYPH_HEIGHT];
+static bool stale[GLYPH_COUNT];
+
+/* Frame of each glyph in CGRAM. Render thread only */
+static uint8_t current_frame[GLYPH_COUNT];
+
+/* Write the current bitmap of the glyph held in a slot to CGRAM */
+static void glyph_upload(lcd_state_t *lcd, uint8_t slot)
+{
+    const glyph_def_t *def = &glyph_defs[slots[slot].glyph];
+    uint8_t id = slots[slot].glyph;
+    uint8_t bitmap[GLYPH_HEIGHT];
+
+    if (def->frames > 0) {
+        lcd_create_char(lcd, slot, glyph_bitmaps[def->first + current_frame[id]]);
+        return;
+    }
+
+    /* Copy the dynamic bitmap out; the bus writes sleep, so they happen outside the lock */
+    k_spinlock_key_t key = k_spin_lock(&anim_lock);
+    memcpy(bitmap, dynamic_bitmaps[def->first], sizeof(bitmap));
+    stale[id] = false;
+    k_spin_unlock(&anim_lock, key);
+
+    lcd_create_char(lcd, slot, bitmap);
+}
+
+/* Empty slot if there is one, else the least recently shown slot not needed by this pass */
+static uint8_t glyph_find_slot(void)
+{
+    uint8_t victim = GLYPH_NONE;
+
+    for (uint8_t slot = 0; slot < GLYPH_SLOTS; slot++) {
+        if (slots[slot].glyph == GLYPH_NONE) {
+            return slot;
+        }
+        if (slots[slot].last_used != pass &&
+            (victim == GLYPH_NONE || slots[slot].last_used < slots[victim].last_used)) {
+            victim = slot;
+        }
+    }
+
+    return victim;
+}
+
+/* Slot holding a glyph, loading it if needed, or GLYPH_NONE when every slot is in use */
+static uint8_t glyph_acquire(lcd_state_t *lcd, glyph_id_t id)
+{
+    uint8_t slot = glyph_slot[id];
+
+    if (slot == GLYPH_NONE) {
+        slot = glyph_find_slot();
+        if (slot == GLYPH_NONE) {
+            if (!overflow_logged) {
+                LOG_WRN("More than %d glyphs on one page", GLYPH_SLOTS);
+                overflow_logged = true;
+            }
+            return GLYPH_NONE;
+        }
+
+        if (slots[slot].glyph != GLYPH_NONE) {
+            glyph_slot[slots[slot].glyph] = GLYPH_NONE;
+        }
+        slots[slot].glyph = id;
+        glyph_slot[id] = slot;
+        glyph_upload(lcd, slot);
+        LOG_DBG("Loaded glyph %u into slot %u", id, slot);
+    } else {
+        k_spinlock_key_t key = k_spin_lock(&anim_lock);
+        bool changed = stale[id];
+        k_spin_unlock(&anim_lock, key);
+
+        /* Changed while off the glass */
+        if (changed) {
+            glyph_upload(lcd, slot);
+        }
+    }
+
+    slots[slot].last_used = pass;
+    return slot;
+}
+
+void glyph_begin_frame(void)
+{
+    pass++;
+}
+
+void glyph_map(lcd_state_t *lcd, uint8_t *out, const uint8_t *in, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = in[i];
+
+        if (c >= GLYPH_CODE_BASE && c < GLYPH_CODE(GLYPH_COUNT)) {
+            uint8_t slot = glyph_acquire(lcd, c - GLYPH_CODE_BASE);
+            c = (slot == GLYPH_NONE) ? ' ' : slot;
+        }
+        out[i] = c;
+    }
+}
+
+void glyph_set_frame_ms(glyph_id_t id, uint16_t ms)
+{
+    if (id >= GLYPH_COUNT) {
+        return;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&anim_lock);
+    if (frame_ms[id] == 0 && ms != 0) {
+        frame_due[id] = k_uptime_get() + ms;
+    }
+    frame_ms[id] = ms;
+    k_spin_unlock(&anim_lock, key);
+}
+
+void glyph_set_bitmap(glyph_id_t id, const uint8_t bitmap[GLYPH_HEIGHT])
+{
+    if (id >= GLYPH_COUNT || glyph_defs[id].frames > 0) {
+        return;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&anim_lock);
+    if (memcmp(dynamic_bitmaps[glyph_defs[id].first], bitmap, GLYPH_HEIGHT) != 0) {
+        memcpy(dynamic_bitmaps[glyph_defs[id].first], bitmap, GLYPH_HEIGHT);
+        stale[id] = true;
+    }
+    k_spin_unlock(&anim_lock, key);
+}
+
+/* Whether a slot holds a glyph shown in the last pass */
+static bool glyph_slot_shown(uint8_t slot)
+{
+    return slots[slot].glyph != GLYPH_NONE && slots[slot].last_used == pass;
+}
+
+/* Whether a slot holds an animating glyph that was shown in the last pass. Call with
+ * anim_lock held */
+static bool glyph_slot_animating(uint8_t slot)
+{
+    uint8_t id = slots[slot].glyph;
+
+    return glyph_slot_shown(slot) && glyph_defs[id].frames > 1 && frame_ms[id] != 0;
+}
+
+int64_t glyph_next_frame(void)
+{
+    int64_t next = INT64_MAX;
+
+    k_spinlock_key_t key = k_spin_lock(&anim_lock);
+    for (uint8_t slot = 0; slot < GLYPH_SLOTS; slot++) {
+        if (glyph_slot_shown(slot) && stale[slots[slot].glyph]) {
+            /* Due straight away */
+            next = 0;
+        } else if (glyph_slot_animating(slot)) {
+            next = MIN(next, frame_due[slots[slot].glyph]);
+        }
+    }
+    k_spin_unlock(&anim_lock, key);
+
+    return next;
+}
+
+void glyph_animate(lcd_state_t *lcd, int64_t now)
+{
+    bool due[GLYPH_SLOTS] = {0};
+
+    k_spinlock_key_t key = k_spin_lock(&anim_lock);
+    for (uint8_t slot = 0; slot < GLYPH_SLOTS; slot++) {
+        uint8_t id = slots[slot].glyph;
+
+        if (glyph_slot_shown(slot) && stale[id]) {
+            due[slot] = true;
+            continue;
+        }
+        if (!glyph_slot_animating(slot) || frame_due[id] > now) {
+            continue;
+        }
+        current_frame[id] = (current_frame[id] + 1) % glyph_defs[id].frames;
+        frame_due[id] += frame_ms[id];
+        if (frame_due[id] <= now) {
+            /* Fell behind; don't try to catch up */
+            frame_due[id] = now + frame_ms[id];
+        }
+        due[slot] = true;
+    }
+    k_spin_unlock(&anim_lock, key);
+
+    /* The bus writes sleep, so they happen outside the lock */
+    for (uint8_t slot = 0; slot < GLYPH_SLOTS; slot++) {
+        if (due[slot]) {
+            glyph_upload(lcd, slot);
+        }
+    }
+}
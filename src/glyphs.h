@@ -0,0 +1,73 @@
+/*
+ * Custom glyph manager: owns the eight CGRAM slots of the LCD
+ *
+ * Page buffers refer to glyphs by model code (GLYPH_CODE(id)), never by slot.
+ * The render thread maps the codes to slots as it copies the visible page to
+ * the LCD, loading glyphs that aren't resident and evicting the least recently
+ * shown ones. Animated glyphs change by rewriting their slot's bitmap, so every
+ * cell showing them follows without any DDRAM writes. Dynamic glyphs get their
+ * bitmap at run time and are reloaded the same way when it changes.
+ *
+ * Everything but glyph_set_frame_ms and glyph_set_bitmap belongs to the render
+ * thread.
+ */
+
+#ifndef GLYPHS_H
+#define GLYPHS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "drivers/lcd/lcd.h"
+
+/* Glyphs that can be placed in a page buffer */
+typedef enum {
+    GLYPH_TEMPERATURE,
+    GLYPH_MEMORY,
+    GLYPH_CPU,
+    GLYPH_FAN,
+    /* Bar cells filled 1-4 columns from the left; empty and full cells use ROM characters */
+    GLYPH_BAR_1,
+    GLYPH_BAR_2,
+    GLYPH_BAR_3,
+    GLYPH_BAR_4,
+    /* Dynamic: sparkline cells */
+    GLYPH_SPARK_CPU_0,
+    GLYPH_SPARK_CPU_1,
+    GLYPH_SPARK_GPU_0,
+    GLYPH_SPARK_GPU_1,
+    GLYPH_COUNT
+} glyph_id_t;
+
+/* Model codes sit below the printable range, which the host never sends */
+#define GLYPH_CODE_BASE     0x10
+#define GLYPH_CODE(id)      (GLYPH_CODE_BASE + (id))
+
+/* Number of CGRAM slots in an HD44780 with 5x8 characters */
+#define GLYPH_SLOTS         8
+
+/* Pixel rows and columns of a 5x8 glyph */
+#define GLYPH_HEIGHT        8
+#define GLYPH_WIDTH         5
+
+/* Start a render pass. Glyphs mapped during one pass never evict each other */
+void glyph_begin_frame(void);
+
+/* Copy len model bytes to out, replacing glyph codes with the slots holding them and loading
+ * glyphs into CGRAM as needed. A glyph that finds no free slot is shown as a space */
+void glyph_map(lcd_state_t *lcd, uint8_t *out, const uint8_t *in, size_t len);
+
+/* Animate a glyph, showing each frame for frame_ms; 0 stops it on its current frame.
+ * Safe to call from any thread */
+void glyph_set_frame_ms(glyph_id_t id, uint16_t frame_ms);
+
+/* Replace the bitmap of a dynamic glyph; ignored for the others. Safe to call from any thread */
+void glyph_set_bitmap(glyph_id_t id, const uint8_t bitmap[GLYPH_HEIGHT]);
+
+/* Uptime in ms at which a glyph shown in the last pass next needs its slot rewritten, because an
+ * animation frame is due or its bitmap changed, or INT64_MAX */
+int64_t glyph_next_frame(void);
+
+/* Rewrite the CGRAM slots of shown glyphs that are due a frame or have a new bitmap */
+void glyph_animate(lcd_state_t *lcd, int64_t now);
+
+#endif /* GLYPHS_H */
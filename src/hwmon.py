@@ -0,0 +1,166 @@
+"""Linux sensor collectors that read sysfs and procfs directly
+
+psutil walks and parses the whole /sys/class/hwmon tree on every sensors_*() call. These
+collectors find the files they need once, keep them open and re-read them from offset 0
+with os.pread, so a sample is one system call plus a short parse. Any file that can't be
+found falls back to the psutil path.
+
+Run this file directly to compare the cost of a sample against psutil.
+"""
+import glob
+import os
+import time
+
+import psutil
+
+HWMON_ROOT = "/sys/class/hwmon"
+
+# hwmon drivers that report the CPU package temperature as temp1 (Intel, AMD)
+CPU_TEMP_DRIVERS = ("coretemp", "k10temp")
+
+class KernelFile:
+    """A small sysfs or procfs file kept open and re-read from the start on every sample"""
+    def __init__(self, path):
+        self.path = path
+        self.fd = os.open(path, os.O_RDONLY)
+
+    def read(self):
+        return os.pread(self.fd, 4096, 0)
+
+    def read_int(self):
+        return int(self.read())
+
+    def close(self):
+        os.close(self.fd)
+
+def open_optional(path):
+    """Open a kernel file, or return None if this machine doesn't have it"""
+    try:
+        return KernelFile(path)
+    except OSError:
+        return None
+
+def find_hwmon(name):
+    """Directory of the first hwmon device whose driver is called name, or None"""
+    for path in sorted(glob.glob(os.path.join(HWMON_ROOT, "hwmon*"))):
+        try:
+            with open(os.path.join(path, "name")) as f:
+                if f.read().strip() == name:
+                    return path
+        except OSError:
+            continue
+    return None
+
+class LinuxCollector:
+    """Reads CPU, memory and AMD GPU metrics. The gpu_* methods return None when the
+    sysfs file is missing so the caller can use pyamdgpuinfo instead"""
+    def __init__(self):
+        cpu_hwmon = next((p for p in map(find_hwmon, CPU_TEMP_DRIVERS) if p), None)
+        self.cpu_temp = open_optional(os.path.join(cpu_hwmon, "temp1_input")) if cpu_hwmon else None
+
+        gpu_hwmon = find_hwmon("amdgpu")
+        self.gpu_temp = None
+        self.gpu_fan = None
+        self.gpu_busy = None
+        self.vram_used = None
+        self.vram_total = 0
+        if gpu_hwmon:
+            device = os.path.join(gpu_hwmon, "device")
+            self.gpu_temp = open_optional(os.path.join(gpu_hwmon, "temp1_input"))
+            self.gpu_fan = open_optional(os.path.join(gpu_hwmon, "fan1_input"))
+            self.gpu_busy = open_optional(os.path.join(device, "gpu_busy_percent"))
+            self.vram_used = open_optional(os.path.join(device, "mem_info_vram_used"))
+            vram_total = open_optional(os.path.join(device, "mem_info_vram_total"))
+            if vram_total:
+                # Doesn't change while running
+                self.vram_total = vram_total.read_int()
+                vram_total.close()
+
+        self.stat = open_optional("/proc/stat")
+        self.meminfo = open_optional("/proc/meminfo")
+        self.last_cpu_times = None
+
+    def sources(self):
+        """Which metrics are read directly, for logging"""
+        names = ("cpu_temp", "gpu_temp", "gpu_fan", "gpu_busy", "vram_used", "stat", "meminfo")
+        return {name: getattr(self, name) is not None for name in names}
+
+    def cpu_temp_c(self):
+        if self.cpu_temp:
+            return self.cpu_temp.read_int() / 1000
+        return psutil.sensors_temperatures()["coretemp"][0].current
+
+    def cpu_percent(self):
+        """CPU busy percentage since the previous call"""
+        if not self.stat:
+            return psutil.cpu_percent(interval=None)
+        # "cpu user nice system idle iowait irq softirq steal ..."
+        fields = self.stat.read().split(b"\n", 1)[0].split()
+        times = [int(x) for x in fields[1:9]]
+        idle = times[3] + times[4]
+        total = sum(times)
+        last = self.last_cpu_times
+        self.last_cpu_times = (idle, total)
+        if last is None or total == last[1]:
+            return 0.0
+        return 100 * (1 - (idle - last[0]) / (total - last[1]))
+
+    def mem_percent(self):
+        """Used memory as a percentage, computed the way psutil.virtual_memory() does"""
+        if not self.meminfo:
+            return psutil.virtual_memory().percent
+        total = available = None
+        for line in self.meminfo.read().split(b"\n"):
+            if line.startswith(b"MemTotal:"):
+                total = int(line.split()[1])
+            elif line.startswith(b"MemAvailable:"):
+                available = int(line.split()[1])
+                break
+        if not total or available is None:
+            return psutil.virtual_memory().percent
+        return 100 * (total - available) / total
+
+    def gpu_temp_c(self):
+        return self.gpu_temp.read_int() / 1000 if self.gpu_temp else None
+
+    def gpu_fan_rpm(self):
+        if self.gpu_fan:
+            return self.gpu_fan.read_int()
+        return psutil.sensors_fans()["amdgpu"][0].current
+
+    def gpu_percent(self):
+        return self.gpu_busy.read_int() if self.gpu_busy else None
+
+    def vram_percent(self):
+        if not self.vram_used or not self.vram_total:
+            return None
+        return 100 * self.vram_used.read_int() / self.vram_total
+
+def benchmark(iterations=2000):
+    """Print the cost of one sample through each path"""
+    collector = LinuxCollector()
+    print(f"Direct sources: {collector.sources()}")
+
+    def time_it(name, fn):
+        try:
+            fn()
+        except Exception as e:
+            print(f"{name:<32} unavailable ({e})")
+            return
+        start = time.perf_counter()
+        for _ in range(iterations):
+            fn()
+        elapsed = time.perf_counter() - start
+        print(f"{name:<32} {elapsed / iterations * 1e6:9.1f} us/sample")
+
+    time_it("collector cpu_temp_c", collector.cpu_temp_c)
+    time_it("psutil sensors_temperatures", lambda: psutil.sensors_temperatures()["coretemp"][0].current)
+    time_it("collector cpu_percent", collector.cpu_percent)
+    time_it("psutil cpu_percent", lambda: psutil.cpu_percent(interval=None))
+    time_it("collector mem_percent", collector.mem_percent)
+    time_it("psutil virtual_memory", lambda: psutil.virtual_memory().percent)
+    time_it("collector gpu_fan_rpm", collector.gpu_fan_rpm)
+    time_it("psutil sensors_fans", lambda: psutil.sensors_fans()["amdgpu"][0].current)
+
+if __name__ == "__main__":
+    benchmark()
@@ -17,6 +17,15 @@
 #include <string.h>
 #include "drivers/lcd/lcd.h"
 #include "serialdata.h"
+#include "display.h"
+#include "fmt.h"
+
+#ifdef CONFIG_ADC_EMUL
+#include <zephyr/drivers/adc/adc_emul.h>
+#endif
+#ifdef LCD_EMUL
+#include "drivers/lcd/lcd_emul.h"
+#endif
 
 #ifndef DEBUGMODE
 #define DEBUGMODE
@@ -33,6 +42,9 @@ static lcd_state_t lcd;
 /* Create a ring buffer for storing received data */
 RING_BUF_DECLARE(cdc_rx_rb, RING_BUF_SIZE);
 
+/* Frame parser fed from the ring buffer; keeps partial frames between calls */
+static frame_parser_t parser;
+
 /* Button value ranges based on observed values with pull-down resistor */
 #define BUTTON_RIGHT_MAX    200
 #define BUTTON_UP_MAX       400
@@ -43,60 +55,112 @@ RING_BUF_DECLARE(cdc_rx_rb, RING_BUF_SIZE);
 
 /* Button debouncing parameters */
 #define DEBOUNCE_TIME_MS    50      // Time in ms required for stable button reading
-#define BUTTON_SAMPLE_MS    10      // Time between button samples/*
+#define BUTTON_SAMPLE_MS    10      // Time between button samples while a button is down
+#define BUTTON_IDLE_SAMPLE_MS 50    // Time between button samples while no button is down
+
+/* Raised by the RX interrupt whenever new bytes land in the ring buffer */
+static struct k_poll_signal rx_signal = K_POLL_SIGNAL_INITIALIZER(rx_signal);
+
+/* Given by the button timer each time the keypad should be sampled */
+K_SEM_DEFINE(button_sample_sem, 0, 1);
+
+static void button_timer_expiry(struct k_timer *timer)
+{
+    k_sem_give(&button_sample_sem);
+}
+
+K_TIMER_DEFINE(button_timer, button_timer_expiry, NULL);
+
+#ifdef DEBUGMODE
+/* Main loop instrumentation, logged every LOOP_STATS_INTERVAL_MS */
+#define LOOP_STATS_INTERVAL_MS 10000
+
+struct loop_stats {
+    uint32_t wakeups;
+    uint32_t frames;
+};
+
+static struct loop_stats loop_stats;
+
+/* Cycle count when the ring buffer last went from empty to non-empty */
+static volatile uint32_t rx_burst_start;
+#endif
 
 /* Device structures */
 
+/* Host link: USB CDC-ACM on hardware, or the UART a board overlay picks (a pty on native_sim) */
+#if DT_HAS_CHOSEN(desktop_display_host_uart)
+const struct device *const cdc_dev = DEVICE_DT_GET(DT_CHOSEN(desktop_display_host_uart));
+#else
 const struct device *const cdc_dev = DEVICE_DT_GET_ONE(zephyr_cdc_acm_uart);
+#endif
 
-#ifdef DEBUGMODE
+#if defined(DEBUGMODE) && DT_NODE_EXISTS(DT_NODELABEL(sercom5))
+#define HAS_DEBUG_UART
 const struct device *const uart_dev = DEVICE_DT_GET(DT_NODELABEL(sercom5));
 #endif
 
 /* ADC channel from devicetree */
 static const struct adc_dt_spec adc_channel = ADC_DT_SPEC_GET(DT_PATH(zephyr_user));
 
+/* LCD wiring */
+#ifdef CONFIG_BOARD_NATIVE_SIM
+/* native_sim: all six lines on the emulated GPIO port, decoded by lcd_emul */
+#define LCD_DATA_PORT   DT_NODELABEL(gpio0)
+#define LCD_CTRL_PORT   DT_NODELABEL(gpio0)
+#define LCD_D4_PIN      0
+#define LCD_D5_PIN      1
+#define LCD_D6_PIN      2
+#define LCD_D7_PIN      3
+#define LCD_RS_PIN      4
+#define LCD_ENABLE_PIN  5
+#else
+/* MKR Zero: data lines on PORTA, control lines on PORTB. Comments give the header pin */
+#define LCD_DATA_PORT   DT_NODELABEL(porta)
+#define LCD_CTRL_PORT   DT_NODELABEL(portb)
+#define LCD_D4_PIN      22  /* D0 (PA22) */
+#define LCD_D5_PIN      23  /* D1 (PA23) */
+#define LCD_D6_PIN      10  /* D2 (PA10) */
+#define LCD_D7_PIN      11  /* D3 (PA11) */
+#define LCD_RS_PIN      10  /* D4 (PB10) */
+#define LCD_ENABLE_PIN  11  /* D5 (PB11) */
+#endif
+
 /* Initialize the LCD */
 static int init_lcd(void)
 {
     /* Get GPIO devices */
-    const struct device *porta = DEVICE_DT_GET(DT_NODELABEL(porta));
-    const struct device *portb = DEVICE_DT_GET(DT_NODELABEL(portb));
+    const struct device *data_port = DEVICE_DT_GET(LCD_DATA_PORT);
+    const struct device *ctrl_port = DEVICE_DT_GET(LCD_CTRL_PORT);
 
-    if (!device_is_ready(porta) || !device_is_ready(portb)) {
+    if (!device_is_ready(data_port) || !device_is_ready(ctrl_port)) {
         LOG_ERR("GPIO devices not ready");
         return -ENODEV;
     }
 
-    /* Configure LCD pins according to your wiring:
-     * D0 (PA22) -> LCD D4
-     * D1 (PA23) -> LCD D5
-     * D2 (PA10) -> LCD D6
-     * D3 (PA11) -> LCD D7
-     * D4 (PB10) -> LCD RS
-     * D5 (PB11) -> LCD Enable
-     */
+    /* Pins per board are set by the LCD wiring macros above */
     lcd_config_t config = {
-        /* RS pin - using PB10 (D4) */
-        .rs_gpio_dev = portb,
-        .rs_pin = 10,
+        .rs_gpio_dev = ctrl_port,
+        .rs_pin = LCD_RS_PIN,
+
+        .enable_gpio_dev = ctrl_port,
+        .enable_pin = LCD_ENABLE_PIN,
 
-        /* Enable pin - using PB11 (D5) */
-        .enable_gpio_dev = portb,
-        .enable_pin = 11,
+        /* RW is tied to ground on the shield */
+        .rw_gpio_dev = NULL,
+        .rw_pin = 0xFF,
 
-        /* Data pins - all on PORTA */
-        .d4_gpio_dev = porta,
-        .d4_pin = 22,  /* D0 */
+        .d4_gpio_dev = data_port,
+        .d4_pin = LCD_D4_PIN,
 
-        .d5_gpio_dev = porta,
-        .d5_pin = 23,  /* D1 */
+        .d5_gpio_dev = data_port,
+        .d5_pin = LCD_D5_PIN,
 
-        .d6_gpio_dev = porta,
-        .d6_pin = 10,  /* D2 */
+        .d6_gpio_dev = data_port,
+        .d6_pin = LCD_D6_PIN,
 
-        .d7_gpio_dev = porta,
-        .d7_pin = 11,  /* D3 */
+        .d7_gpio_dev = data_port,
+        .d7_pin = LCD_D7_PIN,
 
         /* No separate backlight control pin */
         .backlight_gpio_dev = NULL,
@@ -108,7 +172,10 @@ static int init_lcd(void)
 
         /* LCD dimensions - standard 16x2 LCD */
         .cols = 16,
-        .rows = 2
+        .rows = 2,
+
+        /* Datasheet defaults for every command class */
+        .timing = {0}
     };
 
     /* Initialize LCD */
@@ -120,31 +187,79 @@ static int init_lcd(void)
         lcd_set_cursor(&lcd, 1, 0);
     }
 
-    lcd_create_char(&lcd, 0, temperature_char);
-    lcd_create_char(&lcd, 1, memory_char);
-    lcd_create_char(&lcd, 2, cpu_char);
-    lcd_create_char(&lcd, 3, fan_char1);
-    lcd_create_char(&lcd, 4, fan_char2);
+#ifdef LCD_BENCHMARK
+    lcd_benchmark_nibble_write(&lcd, 1000);
+    lcd_benchmark_workload(&lcd, 50);
+#endif
+#ifdef FMT_BENCHMARK
+    fmt_benchmark(1000);
+#endif
 
     return ret;
 }
 
 
 
-/* UART interrupt callback function */
+/* CDC RX counters, written by the interrupt callback */
+struct cdc_rx_stats {
+    uint32_t bytes_received;
+    uint32_t bytes_dropped;     /* Lost because the ring buffer was full */
+    uint32_t high_watermark;    /* Most bytes ever waiting in the ring buffer */
+};
+
+static struct cdc_rx_stats rx_stats;
+
+/* Take a consistent copy of the RX counters */
+static void cdc_rx_stats_get(struct cdc_rx_stats *stats)
+{
+    unsigned int key = irq_lock();
+    *stats = rx_stats;
+    irq_unlock(key);
+}
+
+/* UART interrupt callback function, for both directions */
 static void cdc_cb(const struct device *dev, void *user_data)
 {
-    uint8_t byte;
+    uint8_t *space;
+    uint32_t claimed;
+    int read;
 
     /* Process all available data in the CDC FIFO */
     while (uart_irq_update(dev) && uart_irq_is_pending(dev)) {
-        /* If RX data is available, read it */
-        if (uart_irq_rx_ready(dev)) {
-            /* Read a single byte */
-            if (uart_fifo_read(dev, &byte, 1) == 1) {
-                /* Add the byte to our ring buffer */
-                ring_buf_put(&cdc_rx_rb, &byte, 1);
+        /* Keep the TX FIFO topped up from the outgoing queue */
+        if (uart_irq_tx_ready(dev)) {
+            serial_tx_irq_handler(dev);
+        }
+
+        if (!uart_irq_rx_ready(dev)) {
+            continue;
+        }
+
+        /* Read straight into the largest contiguous free region of the ring buffer */
+        claimed = ring_buf_put_claim(&cdc_rx_rb, &space, RING_BUF_SIZE);
+        if (claimed == 0) {
+            /* Ring buffer is full: drain the FIFO anyway and count what was lost */
+            uint8_t discard[16];
+            read = uart_fifo_read(dev, discard, sizeof(discard));
+            if (read > 0) {
+                rx_stats.bytes_dropped += read;
             }
+            continue;
+        }
+
+#ifdef DEBUGMODE
+        if (ring_buf_is_empty(&cdc_rx_rb)) {
+            rx_burst_start = k_cycle_get_32();
+        }
+#endif
+
+        read = uart_fifo_read(dev, space, claimed);
+        ring_buf_put_finish(&cdc_rx_rb, read > 0 ? read : 0);
+
+        if (read > 0) {
+            k_poll_signal_raise(&rx_signal, 0);
+            rx_stats.bytes_received += read;
+            rx_stats.high_watermark = MAX(rx_stats.high_watermark, ring_buf_size_get(&cdc_rx_rb));
         }
     }
 }
@@ -228,14 +343,15 @@ uint8_t btn_map(lcd_button_t button) {
 
 int main(void)
 {
-    uint8_t byte;
     int ret;
     lcd_button_t current_button = BUTTON_NONE;
     lcd_button_t last_button = BUTTON_NONE;
     lcd_button_t stable_button = BUTTON_NONE;  // For debouncing
     bool diagnostic_mode = false;  // Set to true to show raw ADC values
+    struct cdc_rx_stats stats;
+    uint32_t reported_drops = 0;
 
-#ifdef DEBUGMODE
+#ifdef HAS_DEBUG_UART
     if (!device_is_ready(uart_dev)) {
         LOG_ERR("UART device (SERCOM5) not ready");
         return -1;
@@ -253,11 +369,13 @@ int main(void)
     /* Enable CDC ACM RX interrupt */
     uart_irq_rx_enable(cdc_dev);
 
+#ifdef CONFIG_USB_DEVICE_STACK
     ret = usb_enable(NULL);
     if (ret != 0) {
         LOG_ERR("Failed to enable USB");
         return -1;
     }
+#endif
 
     /* Initialize LCD */
     ret = init_lcd();
@@ -279,6 +397,12 @@ int main(void)
         return -1;
     }
 
+#ifdef CONFIG_ADC_EMUL
+    /* No keypad on native_sim: hold the input at full scale, which reads as no button */
+    adc_emul_const_value_set(adc_channel.dev, adc_channel.channel_id,
+                             adc_ref_internal(adc_channel.dev));
+#endif
+
     /* Define ADC sequence for sampling */
     int16_t adc_buf;
     struct adc_sequence sequence = {
@@ -303,12 +427,19 @@ int main(void)
     LOG_INF("All devices initialized");
     LOG_INF("Awaiting host PC initialization command");
 
+    frame_parser_init(&parser);
+
+    struct k_poll_event events[] = {
+        K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, &rx_signal),
+        K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SEM_AVAILABLE, K_POLL_MODE_NOTIFY_ONLY,
+                                 &button_sample_sem),
+    };
+
     // Await init command
     while (1) {
         LOG_INF("Waiting for command");
-        if (ring_buf_get(&cdc_rx_rb, &byte, 1)) {
-            LOG_INF("Buffer has bytes");
-            if (parse_command_from_ring_buf(&cdc_rx_rb, &lcd, &byte)) {
+        if (parse_frames_from_ring_buf(&parser, &cdc_rx_rb) > 0) {
+            if (parser.host_ready) {
                 LOG_INF("Got ready command from host PC");
                 lcd_clear(&lcd);
                 lcd_home(&lcd);
@@ -316,10 +447,7 @@ int main(void)
                 lcd_set_cursor(&lcd, 1, 0);
                 lcd_print(&lcd, "Sending ready");
                 LOG_INF("Sending ready message back to host");
-                const uint8_t readyCmd[2] = {0x00, 0x00};
-                for (size_t i = 0; i < 2; i++) {
-                    uart_poll_out(cdc_dev, readyCmd[i]);
-                }
+                send_ready(cdc_dev, &parser);
                 uint8_t cmd[4] = {
                     0x01,
                     0x01,
@@ -330,27 +458,99 @@ int main(void)
                 break;
             }
         }
-        k_msleep(500);
+
+        /* Sleep until more bytes arrive, re-logging every half second */
+        k_poll(&events[0], 1, K_MSEC(500));
+        k_poll_signal_reset(&rx_signal);
+        events[0].state = K_POLL_STATE_NOT_READY;
     }
 
     lcd_clear(&lcd);
-    /* Main loop */
+
+    /* From here on only the render thread touches the LCD */
+    display_init(&lcd);
+    metric_layout_init();
+    display_set_page(R_PAGE);
+
+    /* Start sampling the keypad at the idle rate */
+    uint32_t sample_ms = BUTTON_IDLE_SAMPLE_MS;
+    k_timer_start(&button_timer, K_MSEC(sample_ms), K_MSEC(sample_ms));
+
+#ifdef DEBUGMODE
+    int64_t stats_since = k_uptime_get();
+#endif
+
+    /* Main loop: sleep until bytes arrive or the keypad is due for sampling */
     while (1) {
+        k_poll(events, ARRAY_SIZE(events), K_FOREVER);
+
+#ifdef DEBUGMODE
+        loop_stats.wakeups++;
+#endif
+
+        if (events[0].state == K_POLL_STATE_SIGNALED) {
+            /* Reset before draining so bytes arriving meanwhile raise it again */
+            k_poll_signal_reset(&rx_signal);
+            events[0].state = K_POLL_STATE_NOT_READY;
+
+            /* Handle every frame that has arrived, complete or not */
+            int frames = parse_frames_from_ring_buf(&parser, &cdc_rx_rb);
+
+#ifdef DEBUGMODE
+            if (frames > 0) {
+                /* The render thread times the burst to the glass once it flushes */
+                loop_stats.frames += frames;
+                display_note_rx(rx_burst_start);
+            }
+#else
+            ARG_UNUSED(frames);
+#endif
+
+            /* The host restarted the handshake; answer so both directions use its framing */
+            if (parser.ready_reply_pending) {
+                LOG_INF("Host renegotiated, framing mode %u", parser.framing);
+                send_ready(cdc_dev, &parser);
+            }
+
+            /* Report RX overflow; RING_BUF_SIZE is too small if this shows up */
+            cdc_rx_stats_get(&stats);
+            if (stats.bytes_dropped != reported_drops) {
+                LOG_WRN("CDC RX overflow: %u bytes dropped, high watermark %u/%u",
+                        stats.bytes_dropped, stats.high_watermark, RING_BUF_SIZE);
+                reported_drops = stats.bytes_dropped;
+            }
+        }
+
+#ifdef DEBUGMODE
+        if (k_uptime_get() - stats_since >= LOOP_STATS_INTERVAL_MS) {
+            struct display_latency latency;
+
+            display_latency_take(&latency);
+            LOG_INF("Loop: %u wakeups, %u frames, RX to glass avg %u us max %u us",
+                    loop_stats.wakeups, loop_stats.frames,
+                    latency.renders ? latency.sum_us / latency.renders : 0, latency.max_us);
+            memset(&loop_stats, 0, sizeof(loop_stats));
+#ifdef LCD_EMUL
+            lcd_emul_log(lcd.config.rows, lcd.config.cols);
+#endif
+            stats_since = k_uptime_get();
+        }
+#endif
+
+        if (events[1].state != K_POLL_STATE_SEM_AVAILABLE) {
+            continue;
+        }
+        k_sem_take(&button_sample_sem, K_NO_WAIT);
+        events[1].state = K_POLL_STATE_NOT_READY;
+
         /* Read ADC value */
         (void)adc_sequence_init_dt(&adc_channel, &sequence);
         int err = adc_read_dt(&adc_channel, &sequence);
         if (err < 0) {
-            LOG_ERR("Could not read ADC (%d)", ret);
-            k_msleep(100);
+            LOG_ERR("Could not read ADC (%d)", err);
             continue;
         }
 
-        /* If there's data in the ring buffer, process it */
-        if (ring_buf_get(&cdc_rx_rb, &byte, 1)) {
-            parse_command_from_ring_buf(&cdc_rx_rb, &lcd, &byte);
-        }
-
-
         /* Get raw ADC value */
         int32_t raw_value;
         raw_value = (int32_t)adc_buf;
@@ -388,13 +588,20 @@ int main(void)
             LOG_INF("current button is: %d", cmd[2]);
 
             send_message(cdc_dev, cmd);
-            lcd_clear(&lcd);
-            ring_buf_reset(&cdc_rx_rb);
+
+            /* Every page is kept rendered, so switching is a local redraw */
+            display_set_page(btn_map(current_button));
             // LOG_INF("Button: %s, ADC: %d", button_name(current_button), raw_value);
         }
 
-        /* Small delay for button sampling */
-        k_msleep(BUTTON_SAMPLE_MS);
+        /* Sample quickly only while a button is down or still settling */
+        uint32_t wanted_ms = (identify_button(raw_value) == BUTTON_NONE &&
+                              stable_button == BUTTON_NONE) ?
+                             BUTTON_IDLE_SAMPLE_MS : BUTTON_SAMPLE_MS;
+        if (wanted_ms != sample_ms) {
+            sample_ms = wanted_ms;
+            k_timer_start(&button_timer, K_MSEC(sample_ms), K_MSEC(sample_ms));
+        }
     }
 
     return 0;
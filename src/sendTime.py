@@ -1,6 +1,9 @@
 import threading
+import asyncio
+import subprocess
+import unicodedata
 from pyexpat.errors import messages
-from queue import Queue
+from queue import Queue, Empty
 import serial
 import time
 from datetime import datetime
@@ -16,6 +19,8 @@ logger = logging.getLogger(__name__)
 import platform
 if platform.system() == "Linux":
     import pyamdgpuinfo
+    import hwmon
+    collector = hwmon.LinuxCollector()
 elif platform.system() == "Windows":
     import wmi
     w = wmi.WMI(namespace="root\\LibreHardwareMonitor")
@@ -44,6 +49,46 @@ class Commands(IntEnum):
     MEM_USE = 0x0A
     SONG = 0x0B
     VRAM_USE = 0x0C
+    BATCH = 0x0D
+    TIME_SYNC = 0x0E
+
+class Framing(IntEnum):
+    LEGACY = 0x00
+    COBS = 0x01
+
+# Seconds between clock resyncs
+TIME_SYNC_INTERVAL = 600
+
+# Unchanged metrics are still resent this often (seconds), so the Arduino recovers from a lost frame
+HEARTBEAT_INTERVAL = 10
+
+# Changes no larger than this are not sent, so noisy sensors don't cause churn. In protocol units
+METRIC_HYSTERESIS = {
+    Commands.CPU_TEMP: 1,
+    Commands.GPU_TEMP: 1,
+    Commands.GPU_FAN_SPEED: 50,
+}
+
+# Seconds between samples of each metric
+SAMPLE_PERIODS = {
+    Commands.CPU_USE: 0.5,
+    Commands.CPU_TEMP: 1,
+    Commands.MEM_USE: 1,
+    Commands.GPU_USE: 0.5,
+    Commands.GPU_TEMP: 1,
+    Commands.GPU_FAN_SPEED: 2,
+    Commands.VRAM_USE: 2,
+    Commands.SONG: 2,
+}
+
+# Longest song text sent; one DDRAM line, which the Arduino scrolls through
+SONG_MAX_LEN = 40
+
+# Seconds between logging the send statistics
+STATS_INTERVAL = 60
+
+# Negotiated during the READY handshake
+framing = Framing.LEGACY
 
 class Displays(IntEnum):
     RIGHT = 0x00
@@ -61,185 +106,472 @@ def calculate_checksum(data):
 
 def verify_checksum(data):
     given_checksum = data[-1]
-    calc_checksum = calculate_checksum(data)
+    calc_checksum = calculate_checksum(data[:-1])
 
     return given_checksum == calc_checksum
 
-def send_command(command, data, ser, do_checksum = True):
-    """Send a command with data and checksum"""
-    # Form the message
+def _crc8_table():
+    """CRC-8/SMBUS (polynomial 0x07) lookup table, matching the firmware"""
+    table = []
+    for i in range(256):
+        crc = i
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+        table.append(crc)
+    return table
+
+CRC8_TABLE = _crc8_table()
+
+def crc8(data):
+    """CRC-8 of a byte array, one table lookup per byte"""
+    crc = 0
+    for byte in data:
+        crc = CRC8_TABLE[crc ^ byte]
+    return crc
+
+def cobs_encode(data):
+    """COBS-encode a byte array; the result contains no zero bytes"""
+    encoded = bytearray([0])
+    code_pos = 0
+    code = 1
+    for byte in data:
+        if byte != 0:
+            encoded.append(byte)
+            code += 1
+        if byte == 0 or code == 0xFF:
+            encoded[code_pos] = code
+            code_pos = len(encoded)
+            encoded.append(0)
+            code = 1
+    encoded[code_pos] = code
+    return encoded
+
+def cobs_decode(data):
+    """Decode a COBS block without its delimiter, or return None if malformed"""
+    decoded = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        decoded += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < len(data):
+            decoded.append(0)
+    return decoded
+
+def encode_frame(command, data, do_checksum = True):
+    """Build a frame in the negotiated framing"""
     message = bytearray([command, len(data)] + data)
 
+    if framing == Framing.COBS:
+        message.append(crc8(message))
+        return cobs_encode(message) + b"\x00"
+
     # Calculate and append checksum
     if do_checksum:
         checksum = calculate_checksum(message)
         message.append(checksum)
-
-    # Send to Arduino
-    ser.write(message)
     return message
 
-def send_current_time(ser):
-    """Send current time using the specified protocol format"""
-    # Get current time
-    now = datetime.now()
-
-    # Extract hours (12-hour format), minutes, and AM/PM flag
-    hour = now.hour % 12
-    if hour == 0:  # Handle midnight/noon case
-        hour = 12
-
-    minute = now.minute
-    is_pm = 1 if now.hour >= 12 else 0
-
-    data = [hour, minute, is_pm]
-    message = send_command(Commands.TIME, data, ser)
-
-    # Debug output
-    time_str = f"{hour}:{minute:02d} {'PM' if is_pm else 'AM'}"
-    return f"Sent time: {time_str} | Bytes: {[hex(b) for b in message]}"
-
-def send_current_date(ser):
-    now = datetime.now()
-    year_parts = [now.year >> 8, now.year & 0xFF]
+# Longest frame the Arduino sends: READY with a framing byte, COBS-encoded plus delimiter
+MAX_DEVICE_FRAME = 8
+
+def device_header_plausible(buffer):
+    """Whether buffer can start a frame from the Arduino; mirrors the firmware's check so
+    both ends resynchronise the same way. Only READY and DISPLAY travel in this direction"""
+    if buffer[0] not in (Commands.READY, Commands.DISPLAY):
+        return False
+    if len(buffer) < 2:
+        return True
+    if buffer[0] == Commands.READY:
+        return buffer[1] <= 0x01
+    return buffer[1] == 0x01 and (len(buffer) < 3 or buffer[2] <= Displays.SELECT)
+
+def extract_frames(buffer):
+    """Remove complete frames from the front of buffer (a bytearray) and return the valid ones
+    as [command, length, data...] lists. A trailing partial frame is left in the buffer."""
+    frames = []
+    if framing == Framing.COBS:
+        # Every delimiter ends exactly one frame, so damage never spreads past it
+        while (end := buffer.find(0)) >= 0:
+            frame = cobs_decode(bytes(buffer[:end]))
+            del buffer[:end + 1]
+            if (frame and len(frame) >= 3 and frame[1] + 3 == len(frame) and
+                    device_header_plausible(frame) and crc8(frame[:-1]) == frame[-1]):
+                frames.append(list(frame[:-1]))
+        if len(buffer) > MAX_DEVICE_FRAME:
+            # Too long to be a frame; what follows up to the next delimiter will fail its CRC
+            del buffer[:]
+    else:
+        while buffer:
+            if not device_header_plausible(buffer):
+                del buffer[:1]
+                continue
+            if len(buffer) < 2:
+                break
+            if buffer[0] == Commands.READY and buffer[1] == 0x00:
+                # A bare READY has no checksum
+                frames.append([Commands.READY, 0x00])
+                del buffer[:2]
+                continue
+            total = buffer[1] + 3
+            if len(buffer) < total:
+                break
+            if verify_checksum(buffer[:total]):
+                frames.append(list(buffer[:total - 1]))
+                del buffer[:total]
+            else:
+                # Slide forward one byte and look for the next frame
+                del buffer[:1]
+    return frames
 
-    data = [now.month, now.day, year_parts[0], year_parts[1]]
+def send_command(command, data, ser, do_checksum = True):
+    """Send a command with data and checksum"""
+    message = encode_frame(command, data, do_checksum)
 
-    message = send_command(Commands.DATE, data, ser)
+    # Send to Arduino
+    ser.write(message)
+    return message
 
-    date_str = f"{now.month:02d}/{now.day:02d}/{now.year}"
-    return f"Sent date: {date_str} | Bytes: {[hex(b) for b in message]}"
+def send_batch(metrics, ser):
+    """Send several metrics in one BATCH frame as (command, data) tuples; returns the frame"""
+    data = []
+    for command, value in metrics:
+        data += [command, len(value)] + value
+    return send_command(Commands.BATCH, data, ser)
+
+class ChangeFilter:
+    """Last-sent cache per metric. Drops values within the metric's hysteresis of what the
+    Arduino already shows, unless the heartbeat interval has passed since it was last sent"""
+    def __init__(self, heartbeat, hysteresis):
+        self.heartbeat = heartbeat
+        self.hysteresis = hysteresis
+        self.last_sent = {}
+        self.sent = 0
+        self.suppressed = 0
+
+    def filter(self, metrics, now):
+        changed = []
+        for command, data in metrics:
+            last = self.last_sent.get(command)
+            if last is not None and now - last[1] < self.heartbeat:
+                old = int.from_bytes(bytes(last[0]), "big")
+                new = int.from_bytes(bytes(data), "big")
+                if len(data) == len(last[0]) and abs(new - old) <= self.hysteresis.get(command, 0):
+                    self.suppressed += 1
+                    continue
+            self.last_sent[command] = (data, now)
+            self.sent += 1
+            changed.append((command, data))
+        return changed
+
+def utc_offset_minutes():
+    """Local offset from UTC in minutes, including daylight saving"""
+    return int(datetime.now().astimezone().utcoffset().total_seconds() // 60)
+
+def send_time_sync(ser):
+    """Send epoch seconds and the UTC offset so the Arduino can keep its own clock"""
+    epoch = int(time.time())
+    offset = utc_offset_minutes()
+    data = list(epoch.to_bytes(4, "big")) + list(offset.to_bytes(2, "big", signed=True))
+    message = send_command(Commands.TIME_SYNC, data, ser)
+    return f"Sent time sync: {epoch} (UTC{offset:+d} min) | Bytes: {[hex(b) for b in message]}"
 
 def process_command(command_data):
+    """Handle a verified frame from the Arduino; returns the new page, False, or None to quit"""
     if command_data == "quit":
         return None
-    if not verify_checksum(command_data[0:-1]): return False
     cmd = Commands(command_data[0])
     match cmd:
         case Commands.READY:
-            return
+            return False
         case Commands.DISPLAY:
             return Displays(command_data[2])
 
-def send_cpu_temp(ser):
+def read_cpu_temp():
     if '_wmi' not in sys.modules:
-        data = [math.ceil(psutil.sensors_temperatures()["coretemp"][0].current)]
-        
+        data = [math.ceil(collector.cpu_temp_c())]
     else:
         data = [math.ceil(next((x for x in hwSensors if x.Name == "Core Max" and x.Parent == intelHWID), None).Value)]
 
-    message = send_command(Commands.CPU_TEMP, data, ser)
-    return f"Sent CPU temperature: {data[0]} | Bytes: {[hex(b) for b in message]}"
+    return data
 
-def send_cpu_use(ser):
+def read_cpu_use():
     if '_wmi' not in sys.modules:
-        data = [math.ceil(psutil.cpu_percent(interval=0.1))]
+        # Usage since the previous call, so sampling never sleeps
+        data = [math.ceil(collector.cpu_percent())]
     else:
         data = [math.ceil(next((x for x in hwSensors if x.Name == "CPU Total" and x.Parent == intelHWID), None).Value)]
 
-    message = send_command(Commands.CPU_USE, data, ser)
-    return f"Sent CPU usage: {data[0]} | Bytes: {[hex(b) for b in message]}"
+    return data
 
-def send_mem_use(ser):
+def read_mem_use():
     if '_wmi' not in sys.modules:
-        data = [math.ceil(psutil.virtual_memory().percent)]
+        data = [math.ceil(collector.mem_percent())]
     else:
         data = [math.ceil(next((x for x in hwSensors if x.Name == "Memory" and x.Parent == memHWID), None).value)]
 
-    message = send_command(Commands.MEM_USE, data, ser)
-    return f"Sent memory usage: {data[0]} | Bytes: {[hex(b) for b in message]}"
+    return data
 
-def send_gpu_temp(gpu, ser):
+def read_gpu_temp(gpu):
     if '_wmi' not in sys.modules:
-        data = [math.ceil(gpu.query_temperature())]
+        temp = collector.gpu_temp_c()
+        if temp is None:
+            temp = gpu.query_temperature()
+        data = [math.ceil(temp)]
     else:
         data = [math.ceil(next((x for x in hwSensors if x.Name == "GPU Core" and x.SensorType == "Temperature" and x.Parent == amdHWID), None).value)]
-    message = send_command(Commands.GPU_TEMP, data, ser)
-    return f"Sent GPU temperature: {data[0]} | Bytes: {[hex(b) for b in message]}"
+    return data
 
-def send_gpu_use(gpu, ser):
+def read_gpu_use(gpu):
     if '_wmi' not in sys.modules:
-        data = [math.ceil(gpu.query_utilisation()[max(gpu.query_utilisation())]*100)]
+        use = collector.gpu_percent()
+        if use is None:
+            utilisation = gpu.query_utilisation()
+            use = utilisation[max(utilisation)]*100
+        data = [math.ceil(use)]
     else:
         data = [math.ceil(next((x for x in hwSensors if x.Name == "GPU Core" and x.SensorType == "Load" and x.Parent == amdHWID), None).value)]
-    message = send_command(Commands.GPU_USE, data, ser)
-    return f"Sent GPU usage: {data[0]} | Bytes: {[hex(b) for b in message]}"
+    return data
 
-def send_gpu_fan_speed(gpu, ser):
+def read_gpu_fan_speed(gpu):
     if '_wmi' not in sys.modules:
-        speed = psutil.sensors_fans()["amdgpu"][0].current
+        speed = collector.gpu_fan_rpm()
     else:
         speed = math.ceil(next((x for x in hwSensors if x.Name == "GPU Fan" and x.SensorType == "Fan" and x.Parent == amdHWID), None).value)    
     data = [speed >> 8, speed & 0xFF]
-    message = send_command(Commands.GPU_FAN_SPEED, data, ser)
-    return f"Sent GPU fan speed: {data[0]} | Bytes: {[hex(b) for b in message]}"
+    return data
 
-def send_vram_use(gpu, ser):
+def read_vram_use(gpu):
     if '_wmi' not in sys.modules:
-        data = [math.ceil(gpu.query_vram_usage() / gpu.memory_info["vram_size"])]
+        use = collector.vram_percent()
+        if use is None:
+            use = gpu.query_vram_usage() / gpu.memory_info["vram_size"] * 100
+        data = [math.ceil(use)]
     else:
         data = [math.ceil(next((x for x in hwSensors if x.Name == "GPU Memory" and x.SensorType == "Load" and x.Parent == amdHWID), None).value)]
-    message = send_command(Commands.VRAM_USE, data, ser)
-    return f"Sent VRAM usage: {data[0]} | Bytes: {[hex(b) for b in message]}"
-
-
-def send_not_implemented_msg(disp, ser):
-    msg = "Not Done"
-    data = [int(ord(c)) for c in msg]
-    data.append(int(disp))
-
-    message = send_command(Commands.SONG, data, ser)
+    return data
+
+
+# Typographic punctuation common in titles, and the ASCII the LCD can show instead
+LCD_PUNCTUATION = str.maketrans("\u2010\u2013\u2014\u2018\u2019\u201c\u201d", "---''\"\"")
+
+def lcd_text(text, limit):
+    """Character codes of text that the LCD's ROM shows as expected, cut to limit characters.
+    Accents are dropped, and the ROM has a yen sign and arrows in place of \\ ~ and DEL"""
+    text = text.translate(LCD_PUNCTUATION)
+    text = unicodedata.normalize("NFKD", text).encode("ascii", "ignore").decode()
+    text = text.replace("\\", "/").replace("~", "-")
+    return [ord(c) for c in text if 0x20 <= ord(c) < 0x7E][:limit]
+
+async def windows_media_session():
+    """(artist, title) of the current media session, or empty strings when nothing is playing"""
+    from winsdk.windows.media.control import GlobalSystemMediaTransportControlsSessionManager as Manager
+    session = (await Manager.request_async()).get_current_session()
+    if session is None:
+        return "", ""
+    info = await session.try_get_media_properties_async()
+    return info.artist, info.title
+
+def read_song():
+    """"Artist - Title" of whatever is playing; empty when nothing is or no player can be asked.
+    Linux asks MPRIS players through playerctl, Windows the media session through winsdk"""
+    if '_wmi' not in sys.modules:
+        try:
+            result = subprocess.run(["playerctl", "metadata", "--format", "{{artist}}\t{{title}}"],
+                                    capture_output=True, text=True, timeout=1)
+        except (FileNotFoundError, subprocess.TimeoutExpired):
+            return []
+        if result.returncode != 0:
+            # No player running
+            return []
+        artist, _, title = result.stdout.rstrip("\n").partition("\t")
+    else:
+        try:
+            artist, title = asyncio.run(windows_media_session())
+        except ImportError:
+            return []
+    return lcd_text(f"{artist} - {title}" if artist else title, SONG_MAX_LEN)
+
+def refresh_wmi_sensors():
+    """Re-read every LibreHardwareMonitor sensor; the Windows read_* functions use this snapshot"""
+    global hwSensors
+    hwSensors = w.Sensor()
 
-    song_str = f"{msg}"
-    return f"Sent song: {song_str} | Bytes: {[hex(b) for b in message]}"
+class SensorSampler(threading.Thread):
+    """Polls each metric at its own rate into a snapshot, so the writer never waits on a sensor"""
+    def __init__(self, gpu):
+        super().__init__(daemon=True)
+        self.lock = threading.Lock()
+        self.stop_event = threading.Event()
+        self.values = {}
+        # (command or None, read function, period in seconds). The clock is kept by the Arduino
+        self.sources = [
+            (Commands.CPU_USE, read_cpu_use, SAMPLE_PERIODS[Commands.CPU_USE]),
+            (Commands.CPU_TEMP, read_cpu_temp, SAMPLE_PERIODS[Commands.CPU_TEMP]),
+            (Commands.MEM_USE, read_mem_use, SAMPLE_PERIODS[Commands.MEM_USE]),
+            (Commands.GPU_USE, lambda: read_gpu_use(gpu), SAMPLE_PERIODS[Commands.GPU_USE]),
+            (Commands.GPU_TEMP, lambda: read_gpu_temp(gpu), SAMPLE_PERIODS[Commands.GPU_TEMP]),
+            (Commands.GPU_FAN_SPEED, lambda: read_gpu_fan_speed(gpu), SAMPLE_PERIODS[Commands.GPU_FAN_SPEED]),
+            (Commands.VRAM_USE, lambda: read_vram_use(gpu), SAMPLE_PERIODS[Commands.VRAM_USE]),
+            (Commands.SONG, read_song, SAMPLE_PERIODS[Commands.SONG]),
+        ]
+        if '_wmi' in sys.modules:
+            # One sensor enumeration feeds all the Windows reads; keep it first so it runs before them
+            self.sources.insert(0, (None, refresh_wmi_sensors, min(SAMPLE_PERIODS.values())))
+
+    def snapshot(self):
+        """Latest value of every metric sampled so far, as (command, data) tuples"""
+        with self.lock:
+            return list(self.values.items())
+
+    def stop(self):
+        self.stop_event.set()
+
+    def run(self):
+        sample_logger = logging.getLogger("Sampler")
+        if '_wmi' in sys.modules:
+            # COM objects can't be shared between threads; this thread gets its own connection
+            import pythoncom
+            pythoncom.CoInitialize()
+            global w
+            w = wmi.WMI(namespace="root\\LibreHardwareMonitor")
+        next_due = [time.monotonic()] * len(self.sources)
+        while not self.stop_event.is_set():
+            now = time.monotonic()
+            for i, (command, read, period) in enumerate(self.sources):
+                if now < next_due[i]:
+                    continue
+                next_due[i] += period
+                if next_due[i] < now:
+                    # Fell behind, e.g. a slow sensor; don't try to catch up
+                    next_due[i] = now + period
+                try:
+                    data = read()
+                except Exception as e:
+                    sample_logger.warning(f"Reading {command.name if command else 'sensors'} failed: {e}")
+                    continue
+                if command is not None:
+                    with self.lock:
+                        self.values[command] = data
+            self.stop_event.wait(max(0, min(next_due) - time.monotonic()))
+
+class FrameAccumulator:
+    """Collects the frames of one tick so they reach the port in a single write. Stands in for
+    the port in send_command; frames are only ever appended or dropped whole, so the Arduino
+    never sees a torn frame"""
+    def __init__(self):
+        self.pending = bytearray()
+        self.pending_frames = 0
+        self.frames_written = 0
+        self.writes = 0
+
+    def write(self, message):
+        self.pending += message
+        self.pending_frames += 1
+
+    def discard(self):
+        del self.pending[:]
+        self.pending_frames = 0
+
+    def flush(self, ser):
+        if self.pending:
+            ser.write(self.pending)
+            self.writes += 1
+            self.frames_written += self.pending_frames
+        self.discard()
+
+def read_serial(ser, q, stop_event):
+    """Read whatever has arrived, blocking up to the port timeout for the first byte, and hand
+    decoded frames to the writer without waiting for it"""
+    read_logger = logging.getLogger("SerialRead")
+    rx_buffer = bytearray()
+    while not stop_event.is_set():
+        try:
+            chunk = ser.read(ser.in_waiting or 1)
+        except serial.SerialException as e:
+            read_logger.critical(f"Error: {e}")
+            q.put("quit")
+            return
+        if not chunk:
+            continue
+        rx_buffer += chunk
+        for frame in extract_frames(rx_buffer):
+            read_logger.info(f"Received frame: {frame}")
+            q.put_nowait(frame)
 
-def write_serial(ser, q):
+def write_serial(ser, q, sampler, heartbeat):
     write_logger = logging.getLogger("SerialWrite")
+    changes = ChangeFilter(heartbeat, METRIC_HYSTERESIS)
+    out = FrameAccumulator()
+    last_stats = time.monotonic()
     disp = Displays.RIGHT
-    GPU = 0
-    if 'pyamdgpuinfo' in sys.modules:
-        GPU = pyamdgpuinfo.get_gpu(0)
-        GPU.start_utilisation_polling()
+    last_song = None
+    last_sync = -TIME_SYNC_INTERVAL
+    last_offset = None
+    next_tick = time.monotonic()
     while True:
-        if not q.empty():
-            cmd = q.get()
+        # Sleep until the next tick, but handle anything from the Arduino as soon as it arrives
+        try:
+            cmd = q.get(timeout=max(0, next_tick - time.monotonic()))
+        except Empty:
+            cmd = None
+        if cmd is not None:
             disp = process_command(cmd)
             if disp == None:
                 break
-            elif disp:
-                if ser.out_waiting > 0:
-                    ser.reset_output_buffer()
-                write_logger.info(f"Switching to write to display {disp.name}")
-            q.task_done()
+            elif disp is not False:
+                write_logger.info(f"Arduino switched to display {disp.name}")
+            continue
+        next_tick += 1
+        if next_tick < time.monotonic():
+            next_tick = time.monotonic() + 1
         try:
-            match disp:
-                case Displays.RIGHT:
-                    write_logger.info(send_current_time(ser))
-                    write_logger.info(send_current_date(ser))
-                case Displays.UP:
-                    write_logger.info(send_cpu_temp(ser))
-                    write_logger.info(send_mem_use(ser))
-                    write_logger.info(send_cpu_use(ser))
-                case Displays.DOWN:
-                    write_logger.info(send_gpu_temp(GPU, ser))
-                    write_logger.info(send_gpu_use(GPU, ser))
-                    write_logger.info(send_gpu_fan_speed(GPU, ser))
-                    write_logger.info(send_vram_use(GPU, ser))
-                case _:
-                    write_logger.info(send_not_implemented_msg(disp, ser))
-                    while q.empty():
-                        time.sleep(1)
+            # The Arduino keeps its own clock; resync now and then to correct drift,
+            # and straight away if the UTC offset changed (daylight saving)
+            if time.monotonic() - last_sync >= TIME_SYNC_INTERVAL or utc_offset_minutes() != last_offset:
+                write_logger.info(send_time_sync(out))
+                last_sync = time.monotonic()
+                last_offset = utc_offset_minutes()
+            # The Arduino caches every page, so metrics are sent whichever page is shown,
+            # but only when they changed or are due a heartbeat
+            metrics = changes.filter(sampler.snapshot(), time.monotonic())
+            # The song doesn't fit in a batch next to the other metrics, so it gets its own frame
+            for command, data in metrics:
+                if command == Commands.SONG:
+                    send_command(Commands.SONG, data, out)
+                    if data != last_song:
+                        write_logger.info("Sent song: %s", bytes(data).decode())
+                        last_song = data
+            metrics = [(command, data) for command, data in metrics if command != Commands.SONG]
+            if metrics:
+                message = send_batch(metrics, out)
+                if write_logger.isEnabledFor(logging.DEBUG):
+                    write_logger.debug("Sent batch: %s | %d bytes",
+                                       ", ".join(f"{Commands(c).name}={v}" for c, v in metrics), len(message))
+            if time.monotonic() - last_stats >= STATS_INTERVAL:
+                write_logger.info("Frames sent: %d in %d writes, metrics sent: %d, metrics suppressed: %d",
+                                  out.frames_written, out.writes, changes.sent, changes.suppressed)
+                last_stats = time.monotonic()
         except Exception as e:
-            logger.citical(e)
+            logger.critical(e)
             disp = Displays.RIGHT
-            continue
-        time.sleep(1)
+        finally:
+            # Everything queued this tick is whole frames; send them together
+            out.flush(ser)
 
 def main():
     logging.basicConfig(filename="myapp.log", level=logging.INFO, filemode='w')
     parser = argparse.ArgumentParser(description="Sends data to arduino")
     parser.add_argument("-p", "--port", type=str, help="Serial port (optional)")
+    parser.add_argument("-f", "--framing", choices=["legacy", "cobs"], default="cobs",
+                        help="Framing to request from the Arduino (default: cobs)")
+    parser.add_argument("--heartbeat", type=float, default=HEARTBEAT_INTERVAL,
+                        help=f"Resend unchanged metrics after this many seconds (default: {HEARTBEAT_INTERVAL})")
     args = parser.parse_args()
+    global framing
+    requested = Framing[args.framing.upper()]
     port='/dev/ttyACM0'
     if args.port:
         port = args.port
@@ -250,37 +582,56 @@ def main():
         # Open serial port
         ser = serial.Serial(port, baud_rate, timeout=1)
         logger.info(f"Connected to {port} at {baud_rate} baud")
+        if platform.system() == "Linux":
+            logger.info(f"Sensors read directly from sysfs/procfs: {collector.sources()}")
 
         q = Queue()
 
         while True:
             logger.info("Waiting for arduino to be ready")
-            send_command(Commands.READY, [], ser, False)
+            if requested == Framing.LEGACY:
+                send_command(Commands.READY, [], ser, False)
+            else:
+                # Ask for a framing mode; the Arduino echoes back the one it picked
+                send_command(Commands.READY, [requested], ser)
             time.sleep(2)
-            if ser.in_waiting > 0:
-                data_in = []
-                data_in.append(int(ser.read(1).hex()))
-                data_in.append(int(ser.read(1).hex()))
-                if data_in == [0x00, 0x00]:
+            if ser.in_waiting >= 2:
+                reply = ser.read(2)
+                if reply == b"\x00\x00":
+                    # Bare reply: legacy request, or firmware without negotiation
+                    framing = Framing.LEGACY
                     logger.info("Arduino is ready")
                     break
-
-        t1 = threading.Thread(target=write_serial, args=(ser,q,))
+                if reply == b"\x00\x01":
+                    mode = ser.read(2)
+                    if len(mode) == 2 and verify_checksum(reply + mode):
+                        framing = Framing(mode[0])
+                        logger.info(f"Arduino is ready, using {framing.name} framing")
+                        break
+
+        GPU = 0
+        if 'pyamdgpuinfo' in sys.modules:
+            GPU = pyamdgpuinfo.get_gpu(0)
+            GPU.start_utilisation_polling()
+        sampler = SensorSampler(GPU)
+        logger.info("Starting sensor sampler thread")
+        sampler.start()
+
+        t1 = threading.Thread(target=write_serial, args=(ser,q,sampler,args.heartbeat,))
         logger.info("Starting serial writer thread")
         t1.start()
 
-        read_logger = logging.getLogger("SerialRead")
-        while True:
-            if ser.in_waiting > 0:
-                data_in = []
-                while ser.in_waiting > 0:
-                    data_in.append(int(ser.read(1).hex()))
-                read_logger.info(f"Received data: {data_in}")
-                q.put(data_in)
-                q.join()
-            global hwSensors
-            hwSensors = w.Sensor()
-            time.sleep(0.1)
+        stop_reading = threading.Event()
+        t2 = threading.Thread(target=read_serial, args=(ser,q,stop_reading,))
+        logger.info("Starting serial reader thread")
+        t2.start()
+
+        # The writer exits on "quit", from us or from the reader on a serial error
+        while t1.is_alive():
+            t1.join(0.5)
+        stop_reading.set()
+        t2.join()
+        sampler.stop()
 
     except serial.SerialException as e:
         logger.critical(f"Error: {e}")
@@ -291,6 +642,10 @@ def main():
         print("Joining serial write thread")
         q.put("quit")
         t1.join()
+        stop_reading.set()
+        logger.info("Joining serial read thread")
+        t2.join()
+        sampler.stop()
         logger.info("Closing serial connection")
         print("Closing serial connection")
         ser.close()
@@ -3,20 +3,21 @@
 //
 
 #include "serialdata.h"
+#include "display.h"
+#include "fmt.h"
+#include "wallclock.h"
 #include <zephyr/drivers/uart.h>
 #include <zephyr/device.h>
 #include <zephyr/logging/log.h>
+#include <string.h>
 
 LOG_MODULE_REGISTER(serialdata, LOG_LEVEL_DBG);
 
 #define DEBUG false
 
 void log_received_data(uint8_t *command) {
-    char dbgBuff[50] = "Received Data (hex): ";
-    for (uint8_t i = 0; i < command[1]+3; i++) {
-        sprintf(dbgBuff + strlen(dbgBuff), "%02x ", command[i]);
-    }
-    LOG_DBG("%s", dbgBuff);
+    /* Length byte plus header and checksum; the parser has already bounded it */
+    LOG_HEXDUMP_DBG(command, command[1] + 3, "Received data");
 }
 
 uint8_t calculate_checksum(uint8_t *data) {
@@ -37,236 +38,509 @@ bool verify_checksum(uint8_t *data) {
     return received_checksum == calc_checksum;
 }
 
+/* Size of the ring buffer for device-to-host frames */
+#define TX_RING_BUF_SIZE 64
+
+/* Frames waiting for the CDC TX interrupt, guarded by tx_lock */
+RING_BUF_DECLARE(cdc_tx_rb, TX_RING_BUF_SIZE);
+static struct k_spinlock tx_lock;
+static uint32_t tx_frames_dropped;
+
+/* Framing for device-to-host frames; legacy until the handshake negotiates otherwise */
+static uint8_t tx_framing = FRAMING_LEGACY;
+
+/* Queue a whole frame for transmission, or drop it if it doesn't fit.
+ * Frames are never split, so the host can't see half a frame. */
+static bool enqueue_frame(const struct device *uart_dev, const uint8_t *frame, size_t len) {
+    bool queued = false;
+    k_spinlock_key_t key = k_spin_lock(&tx_lock);
+
+    if (ring_buf_space_get(&cdc_tx_rb) >= len) {
+        ring_buf_put(&cdc_tx_rb, frame, len);
+        queued = true;
+    } else {
+        tx_frames_dropped++;
+    }
+
+    k_spin_unlock(&tx_lock, key);
+
+    if (!queued) {
+        /* The host isn't reading; newest frames give way rather than stalling the caller */
+        LOG_WRN("TX buffer full, dropped %zu-byte frame (%u dropped)", len, tx_frames_dropped);
+        return false;
+    }
+
+    uart_irq_tx_enable(uart_dev);
+    return true;
+}
+
 void send_message(const struct device *uart_dev, uint8_t *data) {
 
+    LOG_DBG("Sending message %02x", data[0]);
+
+    if (tx_framing == FRAMING_COBS) {
+        uint8_t encoded[FRAME_BUF_LEN + 1];
+        size_t len = data[1] + 2;
+
+        data[len] = crc8(data, len);
+        len = cobs_encode(data, len + 1, encoded);
+        encoded[len++] = 0x00;
+        enqueue_frame(uart_dev, encoded, len);
+        return;
+    }
+
     uint8_t checksum = calculate_checksum(data);
     data[data[1]+2] = checksum;
-    LOG_INF("Sending message");
 
-    for(size_t i = 0; i <= data[1] + 2; i++) {
-      LOG_INF("Sending %02x", data[i]);
-      uart_poll_out(uart_dev, data[i]);
+    enqueue_frame(uart_dev, data, data[1] + 3);
+}
+
+void send_ready(const struct device *uart_dev, frame_parser_t *parser) {
+    if (parser->framing_negotiated) {
+        /* Echo the accepted mode, still in legacy framing: 00 01 <mode> <xor> */
+        const uint8_t ready[4] = {READY_CMD, 0x01, parser->framing, READY_CMD ^ 0x01 ^ parser->framing};
+        enqueue_frame(uart_dev, ready, sizeof(ready));
+    } else {
+        /* Legacy hosts expect a bare "00 00" with no checksum */
+        const uint8_t ready[2] = {READY_CMD, 0x00};
+        enqueue_frame(uart_dev, ready, sizeof(ready));
     }
+
+    tx_framing = parser->framing;
+    parser->ready_reply_pending = false;
 }
 
+void serial_tx_irq_handler(const struct device *uart_dev) {
+    uint8_t *data;
+    k_spinlock_key_t key = k_spin_lock(&tx_lock);
+
+    uint32_t len = ring_buf_get_claim(&cdc_tx_rb, &data, TX_RING_BUF_SIZE);
+    if (len == 0) {
+        /* Nothing left to send */
+        uart_irq_tx_disable(uart_dev);
+    } else {
+        int sent = uart_fifo_fill(uart_dev, data, len);
+        ring_buf_get_finish(&cdc_tx_rb, sent > 0 ? sent : 0);
+    }
 
-bool parse_command_from_ring_buf(struct ring_buf *buf, lcd_state_t *lcd, uint8_t *cmdByte){
-    uint8_t dataLength;
-    ring_buf_get(buf, &dataLength, 1);
-    LOG_INF("Command received: %u", *cmdByte);
-    if (*cmdByte == 0x00) {
-        if (dataLength == 0x00) {
-            return true;
-        }
+    k_spin_unlock(&tx_lock, key);
+}
+
+/* Could these bytes be the start of a host frame? Only checks what has arrived */
+static bool frame_header_plausible(const uint8_t *frame, size_t avail) {
+    if (frame[0] > MAX_HOST_CMD || frame[0] == PAGE_CMD) {
         return false;
     }
+    if (avail < 2) {
+        return true;
+    }
+    if (frame[0] == READY_CMD) {
+        /* Either bare, or carrying a framing request */
+        return frame[1] <= 0x01;
+    }
+    return frame[1] >= 1 && frame[1] <= FRAME_MAX_DATA_LEN;
+}
 
-    uint8_t data[dataLength+4];
-    data[0] = *cmdByte;
-    data[1] = dataLength;
-    for (uint8_t i = 0; i < dataLength + 1; i++) {
-        uint8_t c;
-        ring_buf_get(buf, &c, 1);
-        data[i+2] = c;
+/* Total size of the frame whose header is at the start of the buffer */
+static size_t frame_total_len(const uint8_t *frame) {
+    /* A bare READY is sent as "00 00" with no checksum */
+    if (frame[0] == READY_CMD && frame[1] == 0x00) {
+        return 2;
     }
-    dispatch_command(lcd, data);
-    LOG_INF("Received command");
-    return false;
+    return frame[1] + 3;
 }
 
-void dispatch_command(lcd_state_t *lcd, uint8_t *command) {
-    if (!verify_checksum(command)) {
-        return;
+/* Record the host handshake and the framing it asked for */
+static void frame_parser_handle_ready(frame_parser_t *parser, const uint8_t *frame) {
+    uint8_t requested = FRAMING_LEGACY;
+
+    parser->framing_negotiated = frame[1] == 0x01;
+    if (parser->framing_negotiated) {
+        requested = frame[2];
     }
-    LOG_INF("Command verified");
-    switch (*command) {
-        case DATE_CMD:
-            handle_date_cmd(lcd, command);
-            break;
-        case TIME_CMD:
-            handle_time_cmd(lcd, command);
-            break;
-        case CPU_TEMP_CMD:
-            handle_cpu_temp_cmd(lcd, command);
-            break;
-        case CPU_USE_CMD:
-            handle_cpu_usage_cmd(lcd, command);
-            break;
-        case MEM_USE_CMD:
-            handle_memory_cmd(lcd, command);
-            break;
-        case GPU_TEMP_CMD:
-            handle_gpu_temp_cmd(lcd, command);
-            break;
-        case GPU_USE_CMD:
-            handle_gpu_usage_cmd(lcd, command);
-            break;
-        case GPU_FAN_SPEED_CMD:
-            handle_gpu_fan_speed_cmd(lcd, command);
+
+    /* Unknown modes fall back to legacy; the echo tells the host what was picked */
+    parser->framing = (requested == FRAMING_COBS) ? FRAMING_COBS : FRAMING_LEGACY;
+    parser->host_ready = true;
+    parser->ready_reply_pending = true;
+    LOG_INF("Ready command received, framing mode %u", parser->framing);
+}
+
+/* Decode and handle one COBS block. Returns true if it held a valid frame */
+static bool frame_parser_handle_cobs(frame_parser_t *parser) {
+    size_t len = cobs_decode(parser->frame, parser->pos, parser->frame);
+
+    /* <cmd> <len> <data...> <crc8>, with the length byte agreeing with the block size */
+    if (len < 3 || (size_t)parser->frame[1] + 3 != len ||
+        !frame_header_plausible(parser->frame, len) ||
+        crc8(parser->frame, len - 1) != parser->frame[len - 1]) {
+        LOG_WRN("Bad COBS frame (%zu bytes), dropped", len);
+        parser->checksum_errors++;
+        return false;
+    }
+
+    if (parser->frame[0] == READY_CMD) {
+        frame_parser_handle_ready(parser, parser->frame);
+    } else {
+        parser->dispatch(parser->frame);
+    }
+
+    parser->frames_parsed++;
+    return true;
+}
+
+/* Split incoming bytes on COBS delimiters; every delimiter ends exactly one frame */
+static int frame_parser_feed_cobs(frame_parser_t *parser, const uint8_t *data, size_t len) {
+    int frames = 0;
+
+    while (len > 0) {
+        const uint8_t *delim = memchr(data, 0x00, len);
+        size_t chunk = delim ? (size_t)(delim - data) : len;
+
+        if (parser->discarding) {
+            parser->bytes_skipped += chunk;
+        } else if (parser->pos + chunk > sizeof(parser->frame)) {
+            /* Longer than any valid frame: drop it up to the next delimiter */
+            parser->bytes_skipped += parser->pos + chunk;
+            parser->pos = 0;
+            parser->discarding = true;
+        } else {
+            memcpy(parser->frame + parser->pos, data, chunk);
+            parser->pos += chunk;
+        }
+
+        if (delim == NULL) {
             break;
-        case VRAM_USE_CMD:
-            handle_vram_cmd(lcd, command);
+        }
+
+        if (!parser->discarding && parser->pos > 0 && frame_parser_handle_cobs(parser)) {
+            frames++;
+        }
+        parser->pos = 0;
+        parser->discarding = false;
+
+        data += chunk + 1;
+        len -= chunk + 1;
+    }
+
+    return frames;
+}
+
+/* Drop the first n buffered bytes */
+static void frame_parser_consume(frame_parser_t *parser, size_t n) {
+    parser->pos -= n;
+    memmove(parser->frame, parser->frame + n, parser->pos);
+}
+
+/* Skip ahead to the next buffered byte that could start a frame */
+static void frame_parser_resync(frame_parser_t *parser) {
+    size_t skip = 1;
+    while (skip < parser->pos &&
+           !frame_header_plausible(parser->frame + skip, parser->pos - skip)) {
+        skip++;
+    }
+    parser->bytes_skipped += skip;
+    frame_parser_consume(parser, skip);
+}
+
+/* Handle every complete frame at the start of the buffer */
+static int frame_parser_scan(frame_parser_t *parser) {
+    int frames = 0;
+
+    while (parser->pos > 0) {
+        if (!frame_header_plausible(parser->frame, parser->pos)) {
+            frame_parser_resync(parser);
+            continue;
+        }
+        if (parser->pos < 2) {
             break;
-        case AUDIO_CMD:
-            not_implemented_display(lcd, command);
+        }
+
+        size_t total = frame_total_len(parser->frame);
+        if (parser->pos < total) {
             break;
-        default: return;
+        }
+
+        if (total > 2 && !verify_checksum(parser->frame)) {
+            /* The header was a false match or the frame is damaged */
+            LOG_WRN("Checksum mismatch for command %02x, resyncing", parser->frame[0]);
+            parser->checksum_errors++;
+            frame_parser_resync(parser);
+            continue;
+        }
+
+        if (parser->frame[0] == READY_CMD) {
+            frame_parser_handle_ready(parser, parser->frame);
+        } else {
+            parser->dispatch(parser->frame);
+        }
+
+        frame_parser_consume(parser, total);
+        parser->frames_parsed++;
+        frames++;
+
+        if (parser->framing == FRAMING_COBS) {
+            /* Whatever follows the handshake is already COBS-framed */
+            uint8_t rest[FRAME_BUF_LEN];
+            size_t len = parser->pos;
+
+            memcpy(rest, parser->frame, len);
+            parser->pos = 0;
+            return frames + frame_parser_feed_cobs(parser, rest, len);
+        }
     }
+
+    return frames;
 }
 
-void handle_date_cmd(lcd_state_t *lcd, uint8_t *command) {
+void frame_parser_init(frame_parser_t *parser) {
+    memset(parser, 0, sizeof(*parser));
+    parser->dispatch = dispatch_command;
+}
 
-    if (DEBUG) {
-        log_received_data(command);
-    }
+void frame_parser_discard_partial(frame_parser_t *parser) {
+    parser->pos = 0;
 
-    lcd_set_cursor(lcd, DATE_ROW, DATE_COL);
-    char printStr[14];
-    sprintf(printStr, "%02u/%02u/%u", command[2], command[3], (command[4] << 8) | command[5]);
-    LOG_INF("Received date: %s", printStr);
-    lcd_print(lcd, printStr);
+    /* In COBS mode the rest of the cut frame is skipped up to its delimiter */
+    parser->discarding = parser->framing == FRAMING_COBS;
 }
 
-void handle_time_cmd(lcd_state_t *lcd, uint8_t *command) {
+int parse_frames_from_ring_buf(frame_parser_t *parser, struct ring_buf *buf) {
+    int frames = 0;
+    uint8_t *data;
+    uint32_t len;
+
+    while (true) {
+        if (parser->framing == FRAMING_COBS) {
+            /* Split straight out of the claimed span; only frame bodies are copied */
+            len = ring_buf_get_claim(buf, &data, ring_buf_capacity_get(buf));
+            if (len == 0) {
+                break;
+            }
+            frames += frame_parser_feed_cobs(parser, data, len);
+            ring_buf_get_finish(buf, len);
+            continue;
+        }
 
-    if (DEBUG) {
-        log_received_data(command);
-    }
+        /* Take whatever contiguous data the ring buffer has, as much as the frame buffer can hold */
+        len = ring_buf_get_claim(buf, &data, sizeof(parser->frame) - parser->pos);
+        if (len == 0) {
+            break;
+        }
+        memcpy(parser->frame + parser->pos, data, len);
+        parser->pos += len;
+        ring_buf_get_finish(buf, len);
 
-    lcd_set_cursor(lcd, TIME_ROW, TIME_COL);
-    char printStr[11] = "HH:MM AA";
-    char amPm[3];
-    if (command[4]){
-        sprintf(amPm, "PM");
+        frames += frame_parser_scan(parser);
     }
-    else{
-        sprintf(amPm, "AM");
+
+    return frames;
+}
+
+/* Latest data of every metric, to tell a heartbeat resend from a new value and to sample the
+ * sparklines between frames */
+static uint8_t metric_cache[MAX_HOST_CMD + 1][FRAME_MAX_DATA_LEN];
+static uint8_t metric_cache_len[MAX_HOST_CMD + 1];
+
+/* Latest data received for a metric command, or NULL if none has arrived yet */
+static const uint8_t *metric_cache_get(uint8_t cmd, uint8_t *len) {
+    if (cmd > MAX_HOST_CMD || metric_cache_len[cmd] == 0) {
+        *len = 0;
+        return NULL;
     }
-    sprintf(printStr, "%02u:%02u %s", command[2], command[3], amPm);
-    LOG_INF("Received time: %s", printStr);
-    lcd_print(lcd, printStr);
+    *len = metric_cache_len[cmd];
+    return metric_cache[cmd];
 }
 
-void handle_cpu_temp_cmd(lcd_state_t *lcd, uint8_t *command) {
-    lcd_set_cursor(lcd, CPU_TEMP_ROW, CPU_TEMP_COL);
-    lcd_write_char(lcd, 0);
-    lcd_set_cursor(lcd, CPU_TEMP_ROW, CPU_TEMP_COL + 1);
-    char tempStr[10] = {0};
-    sprintf(tempStr, "%dC", command[2]);
-    LOG_INF("Received CPU temperature: %s", tempStr);
-    lcd_print(lcd, tempStr);
+static void format_date(char *out, uint8_t width, const uint8_t *data, uint8_t len) {
+    fmt_date(out, data[0], data[1], (data[2] << 8) | data[3]);
 }
 
-void handle_cpu_usage_cmd(lcd_state_t *lcd, uint8_t *command) {
-    lcd_set_cursor(lcd, CPU_USE_ROW, CPU_USE_COL);
-    lcd_write_char(lcd, 2);
-    lcd_set_cursor(lcd, CPU_USE_ROW, CPU_USE_COL + 1);
-    char useStr[10] = {0};
-    sprintf(useStr, "%02d%%", command[2]);
-    LOG_INF("Received CPU usage: %s", useStr);
-    lcd_print(lcd, useStr);
+static void format_clock(char *out, uint8_t width, const uint8_t *data, uint8_t len) {
+    fmt_clock(out, data[0], data[1], data[2]);
 }
 
-void handle_memory_cmd(lcd_state_t *lcd, uint8_t *command) {
-    lcd_set_cursor(lcd, MEM_USE_ROW, MEM_USE_COL);
-    lcd_write_char(lcd, 1);
-    lcd_set_cursor(lcd, MEM_USE_ROW, MEM_USE_COL + 1);
-    char memStr[10] = {0};
-    sprintf(memStr, "%d%%", command[2]);
-    LOG_INF("Received memory usage: %s", memStr);
-    lcd_print(lcd, memStr);
+static void format_temperature(char *out, uint8_t width, const uint8_t *data, uint8_t len) {
+    fmt_uint_suffix(out, width, data[0], "C");
 }
 
-void handle_gpu_temp_cmd(lcd_state_t *lcd, uint8_t *command) {
-    lcd_set_cursor(lcd, GPU_TEMP_ROW, GPU_TEMP_COL);
-    lcd_write_char(lcd, 0);
-    lcd_set_cursor(lcd, GPU_TEMP_ROW, GPU_TEMP_COL + 1);
-    char tempStr[10] = {0};
-    sprintf(tempStr, "%dC", command[2]);
-    LOG_INF("Received GPU temperature: %s", tempStr);
-    lcd_print(lcd, tempStr);
+static void format_percent(char *out, uint8_t width, const uint8_t *data, uint8_t len) {
+    fmt_uint_suffix(out, width, data[0], "%");
 }
 
-void handle_gpu_usage_cmd(lcd_state_t *lcd, uint8_t *command) {
-    lcd_set_cursor(lcd, GPU_USE_ROW, GPU_USE_COL);
-    lcd_write_char(lcd, 2);
-    lcd_set_cursor(lcd, GPU_USE_ROW, GPU_USE_COL + 1);
-    char useStr[10] = {0};
-    sprintf(useStr, "%02d%%", command[2]);
-    LOG_INF("Received GPU usage: %s", useStr);
-    lcd_print(lcd, useStr);
+static void format_rpm(char *out, uint8_t width, const uint8_t *data, uint8_t len) {
+    fmt_uint_suffix(out, width, (data[0] << 8) | data[1], "RPM");
 }
 
-void handle_gpu_fan_speed_cmd(lcd_state_t *lcd, uint8_t *command) {
-    lcd_set_cursor(lcd, GPU_FAN_SPEED_ROW, GPU_FAN_SPEED_COL);
-    // if (fan_icon_switch) {
-    //     lcd_write_char(lcd, 3);
-    // }
-    // else {
-    //     lcd_write_char(lcd, 4);
-    // }
-    // fan_icon_switch = !fan_icon_switch;
-    lcd_write_char(lcd, 3);
-    lcd_set_cursor(lcd, GPU_FAN_SPEED_ROW, GPU_FAN_SPEED_COL + 1);
-    char speedStr[16] = {0};
-    sprintf(speedStr, "%dRPM", command[2] << 8 | command[3]);
-    LOG_INF("Received GPU fan speed: %s", speedStr);
-    lcd_print(lcd, speedStr);
+static void format_text(char *out, uint8_t width, const uint8_t *data, uint8_t len) {
+    fmt_text(out, width, data, len);
 }
 
-void handle_vram_cmd(lcd_state_t *lcd, uint8_t *command) {
-    lcd_set_cursor(lcd, VRAM_USE_ROW, VRAM_USE_COL);
-    lcd_write_char(lcd, 1);
-    lcd_set_cursor(lcd, VRAM_USE_ROW, VRAM_USE_COL + 1);
-    char vramStr[10] = {0};
-    sprintf(vramStr, "%02d%%", command[2]);
-    LOG_INF("Received VRAM usage: %s", vramStr);
-    lcd_print(lcd, vramStr);
+/* Spin the fan glyph faster as the fan speeds up; a stopped fan holds still */
+static void animate_fan(const uint8_t *data, uint8_t len) {
+    uint16_t rpm = (data[0] << 8) | data[1];
+    uint16_t frame_ms = 0;
+
+    if (rpm > 0) {
+        frame_ms = CLAMP((uint32_t)FAN_FRAME_MS_AT_1000RPM * 1000 / rpm, FAN_FRAME_MS_MIN, FAN_FRAME_MS_MAX);
+    }
+    display_animate_glyph(GLYPH_FAN, frame_ms);
 }
 
-void handle_song_cmd(lcd_state_t *lcd, uint8_t *command) {
+static bar_widget_t cpu_bar = BAR_WIDGET(U_PAGE, CPU_BAR_ROW, CPU_BAR_COL, CPU_BAR_CELLS);
+static bar_widget_t mem_bar = BAR_WIDGET(U_PAGE, MEM_BAR_ROW, MEM_BAR_COL, MEM_BAR_CELLS);
+static bar_widget_t gpu_bar = BAR_WIDGET(D_PAGE, GPU_BAR_ROW, GPU_BAR_COL, GPU_BAR_CELLS);
+static bar_widget_t vram_bar = BAR_WIDGET(D_PAGE, VRAM_BAR_ROW, VRAM_BAR_COL, VRAM_BAR_CELLS);
+
+static sparkline_widget_t cpu_sparkline =
+    SPARKLINE_WIDGET(U_PAGE, CPU_SPARK_ROW, CPU_SPARK_COL, CPU_SPARK_CELLS, GLYPH_SPARK_CPU_0);
+static sparkline_widget_t gpu_sparkline =
+    SPARKLINE_WIDGET(D_PAGE, GPU_SPARK_ROW, GPU_SPARK_COL, GPU_SPARK_CELLS, GLYPH_SPARK_GPU_0);
+
+/* Where and how every metric command is shown, indexed by command byte. Commands without a
+ * formatter are not displayed. The row and column are those of the glyph; the value follows it */
+static const metric_desc_t metric_table[MAX_HOST_CMD + 1] = {
+    [DATE_CMD]          = { "date",            R_PAGE, DATE_ROW,          DATE_COL,          FMT_DATE_WIDTH,
+                            METRIC_NO_GLYPH,   4, format_date },
+    [TIME_CMD]          = { "time",            R_PAGE, TIME_ROW,          TIME_COL,          FMT_CLOCK_WIDTH,
+                            METRIC_NO_GLYPH,   3, format_clock },
+    [CPU_TEMP_CMD]      = { "CPU temperature", U_PAGE, CPU_TEMP_ROW,      CPU_TEMP_COL,       4,
+                            GLYPH_TEMPERATURE, 1, format_temperature },
+    [CPU_USE_CMD]       = { "CPU usage",       U_PAGE, CPU_USE_ROW,       CPU_USE_COL,        4,
+                            GLYPH_CPU,         1, format_percent,
+                            .bar = &cpu_bar, .sparkline = &cpu_sparkline },
+    [MEM_USE_CMD]       = { "memory usage",    U_PAGE, MEM_USE_ROW,       MEM_USE_COL,        4,
+                            GLYPH_MEMORY,      1, format_percent,     .bar = &mem_bar },
+    [GPU_TEMP_CMD]      = { "GPU temperature", D_PAGE, GPU_TEMP_ROW,      GPU_TEMP_COL,       4,
+                            GLYPH_TEMPERATURE, 1, format_temperature },
+    [GPU_USE_CMD]       = { "GPU usage",       D_PAGE, GPU_USE_ROW,       GPU_USE_COL,        4,
+                            GLYPH_CPU,         1, format_percent,
+                            .bar = &gpu_bar, .sparkline = &gpu_sparkline },
+    [GPU_FAN_SPEED_CMD] = { "GPU fan speed",   D_PAGE, GPU_FAN_SPEED_ROW, GPU_FAN_SPEED_COL,  7,
+                            GLYPH_FAN,         2, format_rpm,         .update = animate_fan },
+    [VRAM_USE_CMD]      = { "VRAM usage",      D_PAGE, VRAM_USE_ROW,      VRAM_USE_COL,       4,
+                            GLYPH_MEMORY,      1, format_percent,     .bar = &vram_bar },
+    [AUDIO_CMD]         = { "song",            L_PAGE, 0,                 0,                 LCD_DDRAM_COLS,
+                            METRIC_NO_GLYPH,   0, format_text,        .marquee = true },
+};
+
+/* The caller is responsible for verifying the checksum first */
+void dispatch_command(uint8_t *command) {
+    uint8_t cmd = command[0];
+
+    if (cmd > MAX_HOST_CMD) {
+        return;
+    }
+    if (cmd == BATCH_CMD) {
+        handle_batch_cmd(command);
+        return;
+    }
+    if (cmd == TIME_SYNC_CMD) {
+        handle_time_sync_cmd(command);
+        return;
+    }
+
+    /* Heartbeat resends of an unchanged value must not restart a marquee */
+    bool changed = metric_cache_len[cmd] != command[1] ||
+                   memcmp(metric_cache[cmd], command + 2, command[1]) != 0;
+
+    if (cmd > READY_CMD && command[1] <= FRAME_MAX_DATA_LEN) {
+        memcpy(metric_cache[cmd], command + 2, command[1]);
+        metric_cache_len[cmd] = command[1];
+    }
+
+    const metric_desc_t *metric = &metric_table[cmd];
+    if (metric->format == NULL) {
+        return;
+    }
+    if (command[1] < metric->min_len) {
+        LOG_WRN("Short %s frame (%u bytes)", metric->name, command[1]);
+        return;
+    }
 
     if (DEBUG) {
         log_received_data(command);
     }
 
-    lcd_set_cursor(lcd, 0, 0);
-    char printStr[17];
-    for (uint8_t i = 2; i < command[1]+2; i++) {
-        sprintf(printStr + strlen(printStr), "%c", command[i]);
+    /* Formatters fill the whole field, so a shorter value clears what was left of a longer one.
+     * They don't terminate it; deferred logging copies the string up to its NUL */
+    char text[LCD_DDRAM_COLS + 1];
+    metric->format(text, metric->width, command + 2, command[1]);
+    text[metric->width] = '\0';
+
+    uint8_t col = metric->col + (metric->glyph != METRIC_NO_GLYPH ? 1 : 0);
+    LOG_INF("Received %s: %s", metric->name, text);
+    display_write(metric->page, metric->row, col, (const uint8_t *)text, metric->width);
+    if (metric->marquee && changed) {
+        display_set_marquee(metric->page, col + MIN(command[1], metric->width));
+    }
+    if (metric->update != NULL) {
+        metric->update(command + 2, command[1]);
+    }
+    if (metric->bar != NULL) {
+        bar_widget_set(metric->bar, command[2]);
+    }
+}
+
+/* Feed every sparkline its metric's latest value at a steady rate, however often it arrives */
+static void sparkline_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(sparkline_work, sparkline_work_handler);
+
+static void sparkline_work_handler(struct k_work *work) {
+    for (uint8_t cmd = 0; cmd <= MAX_HOST_CMD; cmd++) {
+        uint8_t len;
+        const uint8_t *data = metric_cache_get(cmd, &len);
+
+        if (metric_table[cmd].sparkline != NULL && data != NULL) {
+            sparkline_widget_push(metric_table[cmd].sparkline, data[0]);
+        }
     }
-    LOG_INF("Received song: %s", printStr);
-    lcd_print(lcd, printStr);
+
+    k_work_schedule(&sparkline_work, K_MSEC(SPARKLINE_SAMPLE_MS));
 }
 
-void not_implemented_display(lcd_state_t *lcd, uint8_t *command) {
-    lcd_set_cursor(lcd, 0, 0);
-    char printStr[19] = {0};
-    for (uint8_t i = 2; i < command[1]+1; i++) {
-        sprintf(printStr + strlen(printStr), "%c", command[i]);
+void metric_layout_init(void) {
+    for (uint8_t cmd = 0; cmd <= MAX_HOST_CMD; cmd++) {
+        const metric_desc_t *metric = &metric_table[cmd];
+        if (metric->format != NULL && metric->glyph != METRIC_NO_GLYPH) {
+            display_put_char(metric->page, metric->row, metric->col, GLYPH_CODE(metric->glyph));
+        }
     }
+    display_print(S_PAGE, 0, 0, "Not Done");
 
-    LOG_INF("Received data (str): %s", printStr);
-    lcd_print(lcd, printStr);
+    k_work_schedule(&sparkline_work, K_MSEC(SPARKLINE_SAMPLE_MS));
+}
 
-    lcd_set_cursor(lcd, 1, 0);
-    sprintf(printStr, "Page: %u", command[command[1] + 1]);
-    char c;
-    switch (command[command[1] + 1]) {
-        case 0x01:
-            c = '1';
-            break;
-        case 0x02:
-            c = '2';
-            break;
-        case 0x03:
-            c = '3';
-            break;
-        default:
-            c = '0';
-            break;
+void handle_batch_cmd(uint8_t *command) {
+    uint8_t *end = command + 2 + command[1];
+    uint8_t *entry = command + 2;
+
+    /* Each entry is laid out like a frame without a checksum: <cmd> <len> <data...>,
+     * so it can be handed to the regular handlers in place */
+    while (entry + 2 <= end) {
+        uint8_t *next = entry + 2 + entry[1];
+        if (next > end) {
+            LOG_WRN("Truncated batch entry %02x", entry[0]);
+            return;
+        }
+
+        if (entry[0] == BATCH_CMD || entry[0] == READY_CMD || entry[0] == PAGE_CMD) {
+            LOG_WRN("Command %02x not allowed in a batch", entry[0]);
+        } else {
+            dispatch_command(entry);
+        }
+        entry = next;
     }
-    lcd_write_char(lcd, c);
 }
 
+void handle_time_sync_cmd(uint8_t *command) {
+    if (command[1] < 6) {
+        LOG_WRN("Short time sync frame (%u bytes)", command[1]);
+        return;
+    }
 
+    uint32_t epoch = ((uint32_t)command[2] << 24) | ((uint32_t)command[3] << 16) |
+                     ((uint32_t)command[4] << 8) | command[5];
+    int16_t utc_offset_min = (int16_t)((command[6] << 8) | command[7]);
+    wallclock_sync(epoch, utc_offset_min);
+}
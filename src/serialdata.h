@@ -9,7 +9,11 @@
 #include <zephyr/kernel.h>
 #include <zephyr/device.h>
 #include <zephyr/drivers/gpio.h>
+#include <zephyr/sys/ring_buffer.h>
 #include "drivers/lcd/lcd.h"
+#include "framing.h"
+#include "glyphs.h"
+#include "widgets.h"
 
 #define READY_CMD 0x00
 #define PAGE_CMD 0x01
@@ -22,23 +26,40 @@
 #define TIME_ROW 1
 #define TIME_COL 4
 
+/* UP and DOWN pages share one layout, CGRAM slots in brackets:
+ *   row 0: temperature, usage, usage bar, usage sparkline   [2 icons, 1 bar step, 2 sparkline]
+ *   row 1: UP: memory and its bar                           [1 icon, 1 bar step]
+ *          DOWN: fan speed, VRAM and its bar                [2 icons, 1 bar step]
+ * The busier DOWN page needs all 8 slots */
 #define CPU_TEMP_CMD 0x04
 #define CPU_TEMP_ROW 0
-#define CPU_TEMP_COL 2
+#define CPU_TEMP_COL 0
 
 #define CPU_USE_CMD 0x05
 #define CPU_USE_ROW 0
-#define CPU_USE_COL 10
+#define CPU_USE_COL 6
+#define CPU_BAR_ROW 0
+#define CPU_BAR_COL 11
+#define CPU_BAR_CELLS 3
+#define CPU_SPARK_ROW 0
+#define CPU_SPARK_COL 14
+#define CPU_SPARK_CELLS 2
 
 #define CPU_FAN_SPEED_CMD 0x06
 
 #define GPU_TEMP_CMD 0x07
 #define GPU_TEMP_ROW 0
-#define GPU_TEMP_COL 2
+#define GPU_TEMP_COL 0
 
 #define GPU_USE_CMD 0x08
 #define GPU_USE_ROW 0
-#define GPU_USE_COL 10
+#define GPU_USE_COL 6
+#define GPU_BAR_ROW 0
+#define GPU_BAR_COL 11
+#define GPU_BAR_CELLS 3
+#define GPU_SPARK_ROW 0
+#define GPU_SPARK_COL 14
+#define GPU_SPARK_CELLS 2
 
 #define GPU_FAN_SPEED_CMD 0x09
 #define GPU_FAN_SPEED_ROW 1
@@ -46,13 +67,23 @@
 
 #define MEM_USE_CMD 0x0A
 #define MEM_USE_ROW 1
-#define MEM_USE_COL 6
+#define MEM_USE_COL 0
+#define MEM_BAR_ROW 1
+#define MEM_BAR_COL 6
+#define MEM_BAR_CELLS 10
 
 #define AUDIO_CMD 0x0B
 
 #define VRAM_USE_CMD 0x0C
 #define VRAM_USE_ROW 1
-#define VRAM_USE_COL 10
+#define VRAM_USE_COL 8
+#define VRAM_BAR_ROW 1
+#define VRAM_BAR_COL 13
+#define VRAM_BAR_CELLS 3
+
+#define BATCH_CMD 0x0D
+
+#define TIME_SYNC_CMD 0x0E
 
 #define R_PAGE 0x00
 #define U_PAGE 0x01
@@ -60,38 +91,109 @@
 #define L_PAGE 0x03
 #define S_PAGE 0x04
 
+/* Glyph field of a metric shown without an icon */
+#define METRIC_NO_GLYPH 0xFF
 
+/* Fan glyph frame time at 1000 RPM; it scales inversely with speed within the limits */
+#define FAN_FRAME_MS_AT_1000RPM 150
+#define FAN_FRAME_MS_MIN 80
+#define FAN_FRAME_MS_MAX 1000
 
-uint8_t calculate_checksum(uint8_t *data);
+/* Highest command id the host may send */
+#define MAX_HOST_CMD TIME_SYNC_CMD
 
-bool verify_checksum(uint8_t *data);
+/* Largest data length accepted in a frame; longer lengths are treated as corruption */
+#define FRAME_MAX_DATA_LEN 64
 
-void send_message(const struct device *uart_dev, uint8_t *data);
+/* <cmd> <len> <data...> <checksum> */
+#define FRAME_MAX_LEN (FRAME_MAX_DATA_LEN + 3)
+
+/* Room for the largest frame once COBS-encoded */
+#define FRAME_BUF_LEN COBS_MAX_ENCODED_LEN(FRAME_MAX_LEN)
+
+/* Framing modes, requested by the data byte of the host's READY frame */
+#define FRAMING_LEGACY 0x00   /* <cmd> <len> <data...> <xor>, no delimiter */
+#define FRAMING_COBS   0x01   /* COBS(<cmd> <len> <data...> <crc8>) followed by 0x00 */
+
+/* Incremental frame parser state, kept between calls so frames may arrive in pieces */
+typedef struct {
+    uint8_t frame[FRAME_BUF_LEN];
+    size_t pos;
+
+    /* Active framing; switches right after the READY frame that negotiated it */
+    uint8_t framing;
+
+    /* COBS only: dropping an oversized block until the next delimiter */
+    bool discarding;
 
-bool parse_command_from_ring_buf(struct ring_buf *buf, lcd_state_t *lcd, uint8_t *cmdByte);
+    /* Called with every valid frame other than READY; dispatch_command unless overridden */
+    void (*dispatch)(uint8_t *command);
 
-void dispatch_command(lcd_state_t *lcd, uint8_t *command);
+    /* Set once a READY frame has been received */
+    bool host_ready;
 
-void handle_date_cmd(lcd_state_t *lcd, uint8_t *command);
+    /* The READY frame asked for a framing mode and expects it echoed back */
+    bool framing_negotiated;
 
-void handle_time_cmd(lcd_state_t *lcd, uint8_t *command);
+    /* A READY frame is waiting for send_ready. The host may send another at any time, e.g.
+     * after reconnecting, and RX has already switched to the framing it picked */
+    bool ready_reply_pending;
+
+    /* Statistics */
+    uint32_t frames_parsed;
+    uint32_t checksum_errors;
+    uint32_t bytes_skipped;
+} frame_parser_t;
+
+/* Writes the text for a metric into exactly width cells of out, without a NUL terminator */
+typedef void (*metric_format_t)(char *out, uint8_t width, const uint8_t *data, uint8_t len);
+
+/* Extra display work for a metric beyond its text, run every time the metric is received */
+typedef void (*metric_update_t)(const uint8_t *data, uint8_t len);
+
+/* How a metric command is shown. The value fills the whole width so stale characters are cleared */
+typedef struct {
+    const char *name;
+    uint8_t page;
+    uint8_t row;
+    uint8_t col;
+    uint8_t width;
+    uint8_t glyph;
+    uint8_t min_len;
+    metric_format_t format;
+    bool marquee;       /* Value may be wider than the glass; its page scrolls to show it all */
+    metric_update_t update;
+    bar_widget_t *bar;                  /* Percentage metrics only */
+    sparkline_widget_t *sparkline;      /* Percentage metrics only; sampled every SPARKLINE_SAMPLE_MS */
+} metric_desc_t;
+
+uint8_t calculate_checksum(uint8_t *data);
+
+bool verify_checksum(uint8_t *data);
+
+/* Queue a frame for the host and return immediately; the checksum is filled in */
+void send_message(const struct device *uart_dev, uint8_t *data);
 
-void handle_cpu_temp_cmd(lcd_state_t *lcd, uint8_t *command);
+/* Queue the READY handshake reply, then switch TX to the framing the parser negotiated */
+void send_ready(const struct device *uart_dev, frame_parser_t *parser);
 
-void handle_cpu_usage_cmd(lcd_state_t *lcd, uint8_t *command);
+/* Feed the UART TX FIFO from the queue; call from the UART interrupt when TX is ready */
+void serial_tx_irq_handler(const struct device *uart_dev);
 
-void handle_memory_cmd(lcd_state_t *lcd, uint8_t *command);
+void frame_parser_init(frame_parser_t *parser);
 
-void handle_gpu_temp_cmd(lcd_state_t *lcd, uint8_t *command);
+/* Drop a partially received frame, e.g. after the ring buffer was reset. Keeps the framing mode */
+void frame_parser_discard_partial(frame_parser_t *parser);
 
-void handle_gpu_usage_cmd(lcd_state_t *lcd, uint8_t *command);
+int parse_frames_from_ring_buf(frame_parser_t *parser, struct ring_buf *buf);
 
-void handle_gpu_fan_speed_cmd(lcd_state_t *lcd, uint8_t *command);
+void dispatch_command(uint8_t *command);
 
-void handle_vram_cmd(lcd_state_t *lcd, uint8_t *command);
+void handle_batch_cmd(uint8_t *command);
 
-void handle_song_cmd(lcd_state_t *lcd, uint8_t *command);
+void handle_time_sync_cmd(uint8_t *command);
 
-void not_implemented_display(lcd_state_t *lcd, uint8_t *command);
+/* Draw the parts of every page that never change: metric glyphs and placeholder text */
+void metric_layout_init(void);
 
 bool check_host_ready(uint8_t *command);
\ No newline at end of file
@@ -0,0 +1,109 @@
+/*
+ * Wall-clock time kept on the device from occasional host syncs
+ *
+ * The host sends its time once at start-up and then every few minutes. In
+ * between, local time is the synced time plus k_uptime_get() elapsed since the
+ * sync. A delayable work item wakes on each minute boundary to redraw the
+ * clock, and the date only when the day has changed.
+ */
+
+#include "wallclock.h"
+#include "serialdata.h"
+#include "display.h"
+#include "fmt.h"
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(wallclock, LOG_LEVEL_INF);
+
+#define SECONDS_PER_DAY 86400
+
+/* Local time in seconds at uptime sync_uptime_ms, guarded by clock_lock */
+static int64_t sync_local;
+static int64_t sync_uptime_ms;
+static bool synced;
+static struct k_spinlock clock_lock;
+
+/* Day last drawn, to skip redundant date redraws */
+static int64_t drawn_day = -1;
+
+static void wallclock_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(wallclock_work, wallclock_work_handler);
+
+/* Local time now in milliseconds */
+static int64_t wallclock_now_ms(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&clock_lock);
+    int64_t now = sync_local * 1000 + (k_uptime_get() - sync_uptime_ms);
+    k_spin_unlock(&clock_lock, key);
+    return now;
+}
+
+/* Days since 1970-01-01 to a proleptic Gregorian date (Howard Hinnant's civil_from_days) */
+static void civil_from_days(int64_t days, uint16_t *year, uint8_t *month, uint8_t *day)
+{
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    uint32_t doe = (uint32_t)(days - era * 146097);
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp = (5 * doy + 2) / 153;
+
+    *day = doy - (153 * mp + 2) / 5 + 1;
+    *month = mp < 10 ? mp + 3 : mp - 9;
+    *year = (uint16_t)(yoe + era * 400 + (*month <= 2));
+}
+
+static void wallclock_draw(int64_t local)
+{
+    int64_t day = local / SECONDS_PER_DAY;
+    uint32_t second_of_day = local % SECONDS_PER_DAY;
+    uint8_t hour = second_of_day / 3600;
+    uint8_t minute = (second_of_day / 60) % 60;
+    char text[FMT_DATE_WIDTH];
+
+    fmt_clock(text, hour % 12 == 0 ? 12 : hour % 12, minute, hour >= 12);
+    display_write(R_PAGE, TIME_ROW, TIME_COL, (const uint8_t *)text, FMT_CLOCK_WIDTH);
+
+    if (day != drawn_day) {
+        uint16_t year;
+        uint8_t month;
+        uint8_t mday;
+
+        civil_from_days(day, &year, &month, &mday);
+        fmt_date(text, month, mday, year);
+        display_write(R_PAGE, DATE_ROW, DATE_COL, (const uint8_t *)text, FMT_DATE_WIDTH);
+        drawn_day = day;
+    }
+}
+
+static void wallclock_work_handler(struct k_work *work)
+{
+    int64_t now_ms = wallclock_now_ms();
+
+    wallclock_draw(now_ms / 1000);
+
+    /* Sleep until just past the next minute boundary */
+    k_work_reschedule(&wallclock_work, K_MSEC(60000 - now_ms % 60000 + 1));
+}
+
+void wallclock_sync(uint32_t epoch, int16_t utc_offset_min)
+{
+    int64_t local = (int64_t)epoch + utc_offset_min * 60;
+    int64_t drift_ms = 0;
+
+    k_spinlock_key_t key = k_spin_lock(&clock_lock);
+    int64_t uptime_ms = k_uptime_get();
+    if (synced) {
+        drift_ms = sync_local * 1000 + (uptime_ms - sync_uptime_ms) - local * 1000;
+    }
+    sync_local = local;
+    sync_uptime_ms = uptime_ms;
+    synced = true;
+    k_spin_unlock(&clock_lock, key);
+
+    LOG_INF("Clock synced to %u (UTC%+d min), drift %d ms", epoch, utc_offset_min, (int)drift_ms);
+
+    /* Redraw now; the work item then keeps to minute boundaries */
+    k_work_reschedule(&wallclock_work, K_NO_WAIT);
+}
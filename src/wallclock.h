@@ -0,0 +1,14 @@
+/*
+ * Wall-clock time kept on the device from occasional host syncs
+ */
+
+#ifndef WALLCLOCK_H
+#define WALLCLOCK_H
+
+#include <stdint.h>
+
+/* Set the clock from Unix epoch seconds and the host's UTC offset in minutes, then redraw the
+ * date and time. Later syncs only correct drift */
+void wallclock_sync(uint32_t epoch, int16_t utc_offset_min);
+
+#endif /* WALLCLOCK_H */
@@ -0,0 +1,92 @@
+/*
+ * Bar graph and sparkline widgets drawn into the display model with custom glyphs
+ *
+ * Both only touch what changed. A bar moving by a few percent rewrites the one
+ * or two cells around its end. A sparkline never rewrites its cells after the
+ * first draw; scrolling it replaces the bitmaps of its glyphs, which reach the
+ * LCD as CGRAM writes while it is on the glass.
+ */
+
+#include "widgets.h"
+#include "display.h"
+#include <string.h>
+
+/* ROM character with every pixel set */
+#define BAR_FULL_CELL   0xFF
+
+#define BAR_CELL_STEPS  GLYPH_WIDTH
+
+/* Character for a bar cell holding filled steps */
+static uint8_t bar_cell(uint8_t filled)
+{
+    if (filled == 0) {
+        return ' ';
+    }
+    if (filled >= BAR_CELL_STEPS) {
+        return BAR_FULL_CELL;
+    }
+    return GLYPH_CODE(GLYPH_BAR_1 + filled - 1);
+}
+
+void bar_widget_set(bar_widget_t *bar, uint8_t percent)
+{
+    uint16_t total = bar->cells * BAR_CELL_STEPS;
+    uint8_t steps = (MIN(percent, 100) * total + 50) / 100;
+    uint8_t first = 0;
+    uint8_t last = bar->cells - 1;
+    uint8_t text[LCD_DDRAM_COLS];
+
+    if (bar->drawn) {
+        if (steps == bar->steps) {
+            return;
+        }
+        /* Cells holding either end; everything outside them stays full or blank */
+        first = MIN(steps, bar->steps) / BAR_CELL_STEPS;
+        last = MIN(MAX(steps, bar->steps) / BAR_CELL_STEPS, bar->cells - 1);
+    }
+
+    for (uint8_t cell = first; cell <= last; cell++) {
+        int filled = steps - cell * BAR_CELL_STEPS;
+        text[cell - first] = bar_cell(CLAMP(filled, 0, BAR_CELL_STEPS));
+    }
+    display_write(bar->page, bar->row, bar->col + first, text, last - first + 1);
+
+    bar->steps = steps;
+    bar->drawn = true;
+}
+
+void sparkline_widget_push(sparkline_widget_t *spark, uint8_t percent)
+{
+    uint8_t samples = spark->cells * SPARKLINE_CELL_SAMPLES;
+
+    if (!spark->drawn) {
+        uint8_t codes[SPARKLINE_MAX_CELLS];
+
+        for (uint8_t cell = 0; cell < spark->cells; cell++) {
+            codes[cell] = GLYPH_CODE(spark->first_glyph + cell);
+        }
+        display_write(spark->page, spark->row, spark->col, codes, spark->cells);
+        spark->drawn = true;
+    }
+
+    /* Any load at all gets at least one pixel, so idle and light use look different */
+    memmove(spark->heights, spark->heights + 1, samples - 1);
+    spark->heights[samples - 1] = percent == 0 ? 0 :
+                                  MAX(1, (MIN(percent, 100) * GLYPH_HEIGHT + 50) / 100);
+
+    for (uint8_t cell = 0; cell < spark->cells; cell++) {
+        const uint8_t *heights = &spark->heights[cell * SPARKLINE_CELL_SAMPLES];
+        uint8_t bitmap[GLYPH_HEIGHT];
+
+        for (uint8_t row = 0; row < GLYPH_HEIGHT; row++) {
+            bitmap[row] = 0;
+            for (uint8_t x = 0; x < SPARKLINE_CELL_SAMPLES; x++) {
+                /* Columns grow up from the bottom row; bit 4 is the leftmost pixel */
+                if (heights[x] >= GLYPH_HEIGHT - row) {
+                    bitmap[row] |= BIT(SPARKLINE_CELL_SAMPLES - 1 - x);
+                }
+            }
+        }
+        display_set_glyph_bitmap(spark->first_glyph + cell, bitmap);
+    }
+}
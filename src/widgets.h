@@ -0,0 +1,58 @@
+/*
+ * Bar graph and sparkline widgets drawn into the display model with custom glyphs
+ */
+
+#ifndef WIDGETS_H
+#define WIDGETS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "glyphs.h"
+
+/* Sparkline samples per cell, one per pixel column */
+#define SPARKLINE_CELL_SAMPLES  GLYPH_WIDTH
+
+/* Longest sparkline, in cells */
+#define SPARKLINE_MAX_CELLS     2
+
+/* Time between sparkline samples */
+#define SPARKLINE_SAMPLE_MS     3000
+
+/* Horizontal bar showing 0-100% at five steps per cell. Cells are blank, full (the ROM block)
+ * or one of the four GLYPH_BAR_n partial glyphs, so a bar needs at most one CGRAM slot, shared
+ * with every other bar at the same partial step */
+typedef struct {
+    uint8_t page;
+    uint8_t row;
+    uint8_t col;
+    uint8_t cells;
+    uint8_t steps;          /* Filled steps drawn so far */
+    bool drawn;
+} bar_widget_t;
+
+#define BAR_WIDGET(_page, _row, _col, _cells) \
+    { .page = (_page), .row = (_row), .col = (_col), .cells = (_cells) }
+
+/* History of 0-100% values drawn as columns, newest on the right. Each cell is a dynamic glyph,
+ * placed in the page once; new samples only rewrite the glyph bitmaps */
+typedef struct {
+    uint8_t page;
+    uint8_t row;
+    uint8_t col;
+    uint8_t cells;
+    glyph_id_t first_glyph; /* cells consecutive dynamic glyphs */
+    uint8_t heights[SPARKLINE_MAX_CELLS * SPARKLINE_CELL_SAMPLES];  /* Oldest first, in pixels */
+    bool drawn;
+} sparkline_widget_t;
+
+/* cells may be at most SPARKLINE_MAX_CELLS */
+#define SPARKLINE_WIDGET(_page, _row, _col, _cells, _first_glyph) \
+    { .page = (_page), .row = (_row), .col = (_col), .cells = (_cells), .first_glyph = (_first_glyph) }
+
+/* Show a new value. Only the cells between the old and new end of the bar are rewritten */
+void bar_widget_set(bar_widget_t *bar, uint8_t percent);
+
+/* Scroll the sparkline one sample to the left and add percent on the right */
+void sparkline_widget_push(sparkline_widget_t *spark, uint8_t percent);
+
+#endif /* WIDGETS_H */
@@ -0,0 +1,87 @@
+/*
+ * Fixed-width formatter tests
+ *
+ * Every field is formatted into a buffer filled with a marker, so a formatter
+ * that writes past its width or leaves a cell unwritten fails.
+ */
+
+#include "fmt.h"
+#include <zephyr/ztest.h>
+#include <string.h>
+
+/* Widest field the display shows, one DDRAM line */
+#define FIELD_MAX_WIDTH 40
+
+#define FIELD_MARKER '#'
+
+static char field[FIELD_MAX_WIDTH + 1];
+
+static void field_reset(void)
+{
+    memset(field, FIELD_MARKER, sizeof(field));
+}
+
+/* The first width cells must read expected, and the cell after them must be untouched */
+static void check_field(uint8_t width, const char *expected)
+{
+    zassert_mem_equal(field, expected, width, "expected \"%s\", got \"%.*s\"",
+                      expected, width, field);
+    zassert_equal(field[width], FIELD_MARKER, "wrote past %u cells", width);
+}
+
+ZTEST(fmt, test_uint_suffix)
+{
+    field_reset();
+    fmt_uint_suffix(field, 4, 67, "C");
+    check_field(4, " 67C");
+
+    field_reset();
+    fmt_uint_suffix(field, 7, 900, "RPM");
+    check_field(7, " 900RPM");
+}
+
+ZTEST(fmt, test_uint_too_wide)
+{
+    field_reset();
+    fmt_uint_suffix(field, 4, 1000, "%");
+    check_field(4, "---%");
+
+    field_reset();
+    fmt_uint_suffix(field, 2, 5, "RPM");
+    check_field(2, "--");
+}
+
+ZTEST(fmt, test_clock_and_date)
+{
+    field_reset();
+    fmt_clock(field, 8, 28, true);
+    check_field(FMT_CLOCK_WIDTH, "08:28 PM");
+
+    field_reset();
+    fmt_date(field, 3, 14, 2025);
+    check_field(FMT_DATE_WIDTH, "03/14/2025");
+}
+
+ZTEST(fmt, test_text_pad_and_cut)
+{
+    field_reset();
+    fmt_text(field, 12, (const uint8_t *)"Too Sweet", 9);
+    check_field(12, "Too Sweet   ");
+
+    field_reset();
+    fmt_text(field, 4, (const uint8_t *)"Too Sweet", 9);
+    check_field(4, "Too ");
+}
+
+/* Control codes would show as CGRAM characters (0x00-0x07) or reach the render thread as glyph
+ * model codes (GLYPH_CODE_BASE and up); they must come out as spaces */
+ZTEST(fmt, test_text_control_codes)
+{
+    const uint8_t title[] = {'A', 0x00, 0x07, 0x10, 0x1B, 0x1F, 0x7F, 'B', 0xDF};
+
+    field_reset();
+    fmt_text(field, sizeof(title), title, sizeof(title));
+    check_field(sizeof(title), "A      B\xDF");
+}
+
+ZTEST_SUITE(fmt, NULL, NULL, NULL, NULL, NULL);
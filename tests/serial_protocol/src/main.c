@@ -0,0 +1,339 @@
+/*
+ * Host link parser tests and throughput benchmark
+ *
+ * Frames go through the real parser with a counting dispatch hook, so nothing
+ * reaches the display. Every case runs in both framing modes: the DesignDoc
+ * frames as-is for legacy framing, and the same frames re-framed for COBS.
+ * The serial_dispatch suite keeps the real dispatch_command and checks what
+ * lands in the display model instead.
+ */
+
+#include "serialdata.h"
+#include "framing.h"
+#include "display.h"
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <string.h>
+
+/* Example frames from DesignDoc.md, legacy framing */
+static const uint8_t golden_frames[] = {
+    0x02, 0x04, 0x03, 0x0E, 0x07, 0xE9, 0xE5,                               /* Date */
+    0x03, 0x03, 0x08, 0x1C, 0x01, 0x15,                                     /* Time */
+    0x04, 0x01, 0x43, 0x46,                                                 /* CPU temperature */
+    0x05, 0x01, 0x23, 0x27,                                                 /* CPU usage */
+    0x06, 0x02, 0x03, 0x84, 0x83,                                           /* CPU fan speed */
+    0x0A, 0x01, 0x27, 0x2C,                                                 /* Memory usage */
+    0x0B, 0x09, 0x54, 0x6F, 0x6F, 0x20, 0x53, 0x77, 0x65, 0x65, 0x74, 0x26, /* Song */
+    0x0D, 0x06, 0x04, 0x01, 0x43, 0x05, 0x01, 0x23, 0x6A,                   /* Batch */
+    0x0E, 0x06, 0x67, 0xD4, 0xC9, 0x90, 0xFF, 0x10, 0x0D,                   /* Time sync */
+};
+
+#define GOLDEN_FRAME_COUNT 9
+
+/* Room for the golden frames in either framing */
+#define TEST_STREAM_LEN 128
+
+/* Damaged streams tried per framing mode */
+#define CORRUPTION_TRIALS 200
+
+/* Stream passes per framing mode in the benchmark */
+#define THROUGHPUT_ITERATIONS 1000
+
+RING_BUF_DECLARE(test_rb, TEST_STREAM_LEN * 2);
+
+static uint8_t cobs_stream[TEST_STREAM_LEN];
+static size_t cobs_len;
+
+static uint32_t dispatched;
+
+static void test_dispatch(uint8_t *command)
+{
+    dispatched++;
+}
+
+/* Small deterministic generator so runs are comparable */
+static uint32_t test_rand(uint32_t *state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+/* Re-frame the golden frames for COBS: crc8 instead of the XOR byte, encoded, delimited */
+static size_t build_cobs_stream(uint8_t *out)
+{
+    size_t in = 0;
+    size_t len = 0;
+
+    while (in < sizeof(golden_frames)) {
+        uint8_t frame[FRAME_MAX_LEN];
+        size_t frame_len = golden_frames[in + 1] + 2;
+
+        memcpy(frame, &golden_frames[in], frame_len);
+        frame[frame_len] = crc8(frame, frame_len);
+        len += cobs_encode(frame, frame_len + 1, out + len);
+        out[len++] = 0x00;
+        in += frame_len + 1;
+    }
+
+    return len;
+}
+
+static void test_parser_init(frame_parser_t *parser, uint8_t framing)
+{
+    frame_parser_init(parser);
+    parser->dispatch = test_dispatch;
+    parser->framing = framing;
+    ring_buf_reset(&test_rb);
+    dispatched = 0;
+}
+
+/* Feed bytes through the ring buffer and return the frames the parser handled */
+static int test_feed(frame_parser_t *parser, const uint8_t *data, size_t len)
+{
+    ring_buf_put(&test_rb, data, len);
+    return parse_frames_from_ring_buf(parser, &test_rb);
+}
+
+static void check_golden(const uint8_t *stream, size_t len, uint8_t framing)
+{
+    frame_parser_t parser;
+
+    test_parser_init(&parser, framing);
+    zassert_equal(test_feed(&parser, stream, len), GOLDEN_FRAME_COUNT, "frames parsed");
+    zassert_equal(dispatched, GOLDEN_FRAME_COUNT, "frames dispatched");
+    zassert_equal(parser.checksum_errors, 0, "checksum errors");
+    zassert_equal(parser.bytes_skipped, 0, "bytes skipped");
+}
+
+/* Split the stream at every byte boundary; every frame must still arrive exactly once */
+static void check_split(const uint8_t *stream, size_t len, uint8_t framing)
+{
+    frame_parser_t parser;
+
+    for (size_t split = 1; split < len; split++) {
+        test_parser_init(&parser, framing);
+        int frames = test_feed(&parser, stream, split);
+        frames += test_feed(&parser, stream + split, len - split);
+
+        zassert_equal(frames, GOLDEN_FRAME_COUNT, "split at %zu: frames parsed", split);
+        zassert_equal(dispatched, GOLDEN_FRAME_COUNT, "split at %zu: frames dispatched", split);
+        zassert_equal(parser.checksum_errors, 0, "split at %zu: checksum errors", split);
+    }
+}
+
+/* Damage one byte, then send a clean copy. The damage must never produce a full set of frames.
+ * Damage at the end of the stream, e.g. to the last COBS delimiter, can merge the last frame with
+ * the first clean one, so at most that frame may be lost */
+static void check_corruption(const uint8_t *stream, size_t len, uint8_t framing, const char *name)
+{
+    uint8_t damaged[TEST_STREAM_LEN];
+    uint32_t seed = 0x5EED;
+    uint32_t lost = 0;
+    frame_parser_t parser;
+
+    for (uint32_t trial = 0; trial < CORRUPTION_TRIALS; trial++) {
+        memcpy(damaged, stream, len);
+        size_t pos = test_rand(&seed) % len;
+        uint8_t flip = (test_rand(&seed) % 255) + 1;
+        damaged[pos] ^= flip;
+
+        test_parser_init(&parser, framing);
+        int frames = test_feed(&parser, damaged, len);
+        zassert_true(frames < GOLDEN_FRAME_COUNT, "byte %zu ^ %02x went unnoticed", pos, flip);
+
+        /* Frames left partial by the damage may complete here too; count only the clean copy */
+        int recovered = test_feed(&parser, stream, len);
+        recovered = MIN(recovered, GOLDEN_FRAME_COUNT);
+        zassert_true(recovered >= GOLDEN_FRAME_COUNT - 1,
+                     "byte %zu ^ %02x: only %d clean frames recovered", pos, flip, recovered);
+        lost += GOLDEN_FRAME_COUNT - recovered;
+    }
+
+    TC_PRINT("%s: %u/%u clean frames lost after damage\n", name, lost,
+             CORRUPTION_TRIALS * GOLDEN_FRAME_COUNT);
+}
+
+static void *serial_protocol_setup(void)
+{
+    cobs_len = build_cobs_stream(cobs_stream);
+    return NULL;
+}
+
+/* Frame a READY asking for framing mode in the current framing */
+static size_t build_ready(uint8_t *out, uint8_t framing, uint8_t mode)
+{
+    uint8_t frame[4] = {READY_CMD, 0x01, mode, READY_CMD ^ 0x01 ^ mode};
+
+    if (framing == FRAMING_LEGACY) {
+        memcpy(out, frame, sizeof(frame));
+        return sizeof(frame);
+    }
+
+    frame[3] = crc8(frame, 3);
+    size_t len = cobs_encode(frame, sizeof(frame), out);
+    out[len++] = 0x00;
+    return len;
+}
+
+/* A READY after the handshake switches RX straight away and asks the main loop for a reply */
+static void check_renegotiate(uint8_t from, uint8_t to)
+{
+    uint8_t ready[8];
+    frame_parser_t parser;
+
+    test_parser_init(&parser, from);
+    parser.host_ready = true;
+
+    zassert_equal(test_feed(&parser, ready, build_ready(ready, from, to)), 1, "READY parsed");
+    zassert_equal(dispatched, 0, "READY dispatched");
+    zassert_equal(parser.framing, to, "framing after READY");
+    zassert_true(parser.ready_reply_pending, "no reply requested");
+    zassert_true(parser.framing_negotiated, "mode not echoed");
+
+    /* Frames that follow use the new framing */
+    if (to == FRAMING_COBS) {
+        zassert_equal(test_feed(&parser, cobs_stream, cobs_len), GOLDEN_FRAME_COUNT, "frames");
+    } else {
+        zassert_equal(test_feed(&parser, golden_frames, sizeof(golden_frames)),
+                      GOLDEN_FRAME_COUNT, "frames");
+    }
+    zassert_equal(parser.checksum_errors, 0, "checksum errors");
+}
+
+ZTEST(serial_protocol, test_golden_legacy)
+{
+    check_golden(golden_frames, sizeof(golden_frames), FRAMING_LEGACY);
+}
+
+ZTEST(serial_protocol, test_golden_cobs)
+{
+    check_golden(cobs_stream, cobs_len, FRAMING_COBS);
+}
+
+ZTEST(serial_protocol, test_split_legacy)
+{
+    check_split(golden_frames, sizeof(golden_frames), FRAMING_LEGACY);
+}
+
+ZTEST(serial_protocol, test_split_cobs)
+{
+    check_split(cobs_stream, cobs_len, FRAMING_COBS);
+}
+
+ZTEST(serial_protocol, test_corruption_legacy)
+{
+    check_corruption(golden_frames, sizeof(golden_frames), FRAMING_LEGACY, "Legacy");
+}
+
+ZTEST(serial_protocol, test_corruption_cobs)
+{
+    check_corruption(cobs_stream, cobs_len, FRAMING_COBS, "COBS");
+}
+
+ZTEST(serial_protocol, test_renegotiate_to_cobs)
+{
+    check_renegotiate(FRAMING_LEGACY, FRAMING_COBS);
+}
+
+ZTEST(serial_protocol, test_renegotiate_to_legacy)
+{
+    check_renegotiate(FRAMING_COBS, FRAMING_LEGACY);
+}
+
+ZTEST_SUITE(serial_protocol, NULL, serial_protocol_setup, NULL, NULL, NULL);
+
+/* CPU temperature 80C and CPU usage 90% in one batch */
+static const uint8_t batch_frame[] = {0x0D, 0x06, 0x04, 0x01, 0x50, 0x05, 0x01, 0x5A, 0x00};
+
+/* CPU temperature 42C, then a CPU usage entry claiming more data than the frame holds */
+static const uint8_t truncated_batch_frame[] = {
+    0x0D, 0x06, 0x04, 0x01, 0x2A, 0x05, 0x03, 0x11, 0x33
+};
+
+/* Feed legacy frames to a parser that dispatches into the display model */
+static void model_feed(const uint8_t *data, size_t len, int frames)
+{
+    frame_parser_t parser;
+
+    frame_parser_init(&parser);
+    ring_buf_reset(&test_rb);
+    zassert_equal(test_feed(&parser, data, len), frames, "frames parsed");
+    zassert_equal(parser.checksum_errors, 0, "checksum errors");
+}
+
+static void check_cells(uint8_t page, uint8_t row, uint8_t col, const char *expected)
+{
+    uint8_t cells[LCD_DDRAM_COLS];
+    size_t len = strlen(expected);
+
+    zassert_equal(display_read(page, row, col, cells, len), len, "cells read");
+    zassert_mem_equal(cells, expected, len, "page %u row %u col %u: expected \"%s\"",
+                      page, row, col, expected);
+}
+
+ZTEST(serial_dispatch, test_golden_to_model)
+{
+    model_feed(golden_frames, sizeof(golden_frames), GOLDEN_FRAME_COUNT);
+
+    /* The clock sync redraws the same minute the date and time frames show */
+    check_cells(R_PAGE, DATE_ROW, DATE_COL, "03/14/2025");
+    check_cells(R_PAGE, TIME_ROW, TIME_COL, "08:28 PM");
+    check_cells(U_PAGE, CPU_TEMP_ROW, CPU_TEMP_COL + 1, " 67C");
+    check_cells(U_PAGE, CPU_USE_ROW, CPU_USE_COL + 1, " 35%");
+    check_cells(U_PAGE, MEM_USE_ROW, MEM_USE_COL + 1, " 39%");
+    check_cells(L_PAGE, 0, 0, "Too Sweet       ");
+}
+
+ZTEST(serial_dispatch, test_batch_to_model)
+{
+    model_feed(batch_frame, sizeof(batch_frame), 1);
+
+    check_cells(U_PAGE, CPU_TEMP_ROW, CPU_TEMP_COL + 1, " 80C");
+    check_cells(U_PAGE, CPU_USE_ROW, CPU_USE_COL + 1, " 90%");
+}
+
+/* Entries before the truncated one apply; the truncated one is dropped */
+ZTEST(serial_dispatch, test_truncated_batch_to_model)
+{
+    model_feed(batch_frame, sizeof(batch_frame), 1);
+    model_feed(truncated_batch_frame, sizeof(truncated_batch_frame), 1);
+
+    check_cells(U_PAGE, CPU_TEMP_ROW, CPU_TEMP_COL + 1, " 42C");
+    check_cells(U_PAGE, CPU_USE_ROW, CPU_USE_COL + 1, " 90%");
+}
+
+ZTEST_SUITE(serial_dispatch, NULL, serial_protocol_setup, NULL, NULL, NULL);
+
+static void measure_throughput(const uint8_t *stream, size_t len, uint8_t framing, const char *name)
+{
+    frame_parser_t parser;
+    uint32_t frames = 0;
+    uint32_t cycles = 0;
+
+    test_parser_init(&parser, framing);
+    for (uint32_t i = 0; i < THROUGHPUT_ITERATIONS; i++) {
+        uint32_t start = k_cycle_get_32();
+        frames += test_feed(&parser, stream, len);
+        cycles += k_cycle_get_32() - start;
+    }
+
+    zassert_equal(frames, THROUGHPUT_ITERATIONS * GOLDEN_FRAME_COUNT, "frames parsed");
+    zassert_true(cycles > 0, "no cycles counted");
+
+    TC_PRINT("%s: %u cycles per frame, %u frames/s, %zu bytes per %d frames\n",
+             name, cycles / frames,
+             (uint32_t)((uint64_t)sys_clock_hw_cycles_per_sec() * frames / cycles),
+             len, GOLDEN_FRAME_COUNT);
+}
+
+ZTEST(serial_protocol_benchmark, test_throughput_legacy)
+{
+    measure_throughput(golden_frames, sizeof(golden_frames), FRAMING_LEGACY, "Legacy");
+}
+
+ZTEST(serial_protocol_benchmark, test_throughput_cobs)
+{
+    measure_throughput(cobs_stream, cobs_len, FRAMING_COBS, "COBS");
+}
+
+ZTEST_SUITE(serial_protocol_benchmark, NULL, serial_protocol_setup, NULL, NULL, NULL);